@@ -4,9 +4,12 @@
 # cmd=""
 # dir="/"
 # user=""
+# ready=""     "y" if cmd supports --ready-file, start then waits for it
 # source template.inc.sh
 
 pid_file="/var/run/$name.pid"
+ready_file="/var/run/$name.ready"
+ready_timeout_ms=5000
 stdout_log="/var/log/$name.log"
 stderr_log="/var/log/$name.err"
 
@@ -18,6 +21,18 @@ is_running() {
     [ -f "$pid_file" ] && [ -d "/proc/`get_pid`" ] > /dev/null 2>&1
 }
 
+wait_ready() {
+    waited_ms=0
+    while [ ! -f "$ready_file" ]; do
+        if ! is_running || [ $waited_ms -ge $ready_timeout_ms ]; then
+            echo "$name not ready, see $stdout_log and $stderr_log"
+            return 1
+        fi
+        usleep 10000
+        waited_ms=$((waited_ms + 10))
+    done
+}
+
 case "$1" in
     start)
     if is_running; then
@@ -25,6 +40,10 @@ case "$1" in
     else
         echo "Starting $name"
         cd "$dir"
+        rm -f "$ready_file"
+        if [ "$ready" = "y" ]; then
+            cmd="$cmd --ready-file $ready_file"
+        fi
         if [ -z "$user" ]; then
             sudo $cmd >> "$stdout_log" 2>> "$stderr_log" &
         else
@@ -35,6 +54,9 @@ case "$1" in
             echo "Unable to start, see $stdout_log and $stderr_log"
             exit 1
         fi
+        if [ "$ready" = "y" ] && ! wait_ready; then
+            exit 1
+        fi
     fi
     ;;
     stop)
@@ -60,6 +82,7 @@ case "$1" in
             if [ -f "$pid_file" ]; then
                 rm "$pid_file"
             fi
+            rm -f "$ready_file"
         fi
     else
         echo "Not running"
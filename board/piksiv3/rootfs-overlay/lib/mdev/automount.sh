@@ -15,7 +15,8 @@ do_mount()
 {
   mkdir -p "${destdir}/$1" || exit 1
 
-  if ! mount -t auto -o sync "/dev/$1" "${destdir}/$1"; then
+  # Writes are cached and flushed by sd_flush rather than made synchronous
+  if ! mount -t auto -o noatime "/dev/$1" "${destdir}/$1"; then
     # failed to mount, clean up mountpoint
     rmdir "${destdir}/$1"
     exit 1
@@ -0,0 +1,22 @@
+################################################################################
+#
+# daemon_util
+#
+################################################################################
+
+DAEMON_UTIL_VERSION = 0.1
+DAEMON_UTIL_SITE = "${BR2_EXTERNAL}/package/daemon_util/src"
+DAEMON_UTIL_SITE_METHOD = local
+DAEMON_UTIL_INSTALL_STAGING = YES
+DAEMON_UTIL_INSTALL_TARGET = NO
+
+define DAEMON_UTIL_BUILD_CMDS
+    $(MAKE) CC=$(TARGET_CC) AR=$(TARGET_AR) -C $(@D) all
+endef
+
+define DAEMON_UTIL_INSTALL_STAGING_CMDS
+    $(INSTALL) -D -m 0644 $(@D)/libdaemon_util.a $(STAGING_DIR)/usr/lib/libdaemon_util.a
+    $(INSTALL) -D -m 0644 $(@D)/daemon_util.h $(STAGING_DIR)/usr/include/daemon_util.h
+endef
+
+$(eval $(generic-package))
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* sched_setaffinity() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "daemon_util.h"
+
+#define PREFAULT_STACK_SIZE (64 * 1024)
+#define PREFAULT_STRIDE 1024
+
+static int rt_priority = 0;
+static bool cpu_set_valid = false;
+static cpu_set_t cpu_set;
+static bool lock_memory = false;
+static const char *ready_file = NULL;
+
+void daemon_usage(void)
+{
+  puts("\nScheduling options");
+  puts("\t--rt-prio <priority>");
+  puts("\t\trun with SCHED_FIFO at the given priority (1-99)");
+  puts("\t--cpu <cpu>[,<cpu>...]");
+  puts("\t\trestrict to the given CPUs");
+  puts("\t--mlockall");
+  puts("\t\tlock all memory and pre-fault the stack");
+
+  puts("\nStartup options");
+  puts("\t--ready-file <file>");
+  puts("\t\tcreate <file> once startup is complete");
+}
+
+static int cpu_list_parse(const char *list)
+{
+  long cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+  CPU_ZERO(&cpu_set);
+
+  const char *p = list;
+  while (1) {
+    char *end;
+    errno = 0;
+    long cpu = strtol(p, &end, 10);
+    if ((end == p) || (errno != 0) || (cpu < 0) || (cpu >= CPU_SETSIZE) ||
+        ((cpu_count > 0) && (cpu >= cpu_count))) {
+      printf("invalid CPU list\n");
+      return -1;
+    }
+    CPU_SET(cpu, &cpu_set);
+
+    if (*end == '\0') {
+      break;
+    } else if (*end != ',') {
+      printf("invalid CPU list\n");
+      return -1;
+    }
+    p = end + 1;
+  }
+
+  cpu_set_valid = true;
+  return 0;
+}
+
+int daemon_option(int opt_id, const char *arg)
+{
+  switch (opt_id) {
+    case DAEMON_OPT_ID_RT_PRIO: {
+      char *end;
+      long priority = strtol(arg, &end, 10);
+      if ((end == arg) || (*end != '\0') ||
+          (priority < sched_get_priority_min(SCHED_FIFO)) ||
+          (priority > sched_get_priority_max(SCHED_FIFO))) {
+        printf("invalid priority\n");
+        return -1;
+      }
+      rt_priority = priority;
+    }
+    break;
+
+    case DAEMON_OPT_ID_CPU: {
+      if (cpu_list_parse(arg) != 0) {
+        return -1;
+      }
+    }
+    break;
+
+    case DAEMON_OPT_ID_MLOCKALL: {
+      lock_memory = true;
+    }
+    break;
+
+    case DAEMON_OPT_ID_READY_FILE: {
+      ready_file = arg;
+    }
+    break;
+
+    default: {
+      printf("invalid option\n");
+      return -1;
+    }
+    break;
+  }
+
+  return 0;
+}
+
+int daemon_sched_setup(void)
+{
+  if (cpu_set_valid) {
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+      printf("error setting CPU affinity: %s\n", strerror(errno));
+      return -1;
+    }
+  }
+
+  if (rt_priority > 0) {
+    struct sched_param param = { .sched_priority = rt_priority };
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+      printf("error setting SCHED_FIFO: %s\n", strerror(errno));
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int daemon_memory_lock(void)
+{
+  if (!lock_memory) {
+    return 0;
+  }
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    printf("error locking memory: %s\n", strerror(errno));
+    return -1;
+  }
+
+  /* Touch the stack so that it is faulted in before entering the loop.
+   * Each store is through the volatile array so it cannot be elided. */
+  volatile uint8_t stack[PREFAULT_STACK_SIZE];
+  for (size_t i = 0; i < sizeof(stack); i += PREFAULT_STRIDE) {
+    stack[i] = 0;
+  }
+
+  return 0;
+}
+
+void daemon_ready_notify(void)
+{
+  if (ready_file == NULL) {
+    return;
+  }
+
+  int fd = open(ready_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    printf("error creating ready file\n");
+    return;
+  }
+  close(fd);
+}
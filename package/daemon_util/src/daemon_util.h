@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_DAEMON_UTIL_H
+#define SWIFTNAV_DAEMON_UTIL_H
+
+#include <getopt.h>
+
+/* Options shared by the daemons. Add DAEMON_LONG_OPTS to the getopt_long()
+ * table and pass unrecognized option IDs to daemon_option(). */
+enum {
+  DAEMON_OPT_ID_RT_PRIO = 0x1000,
+  DAEMON_OPT_ID_CPU,
+  DAEMON_OPT_ID_MLOCKALL,
+  DAEMON_OPT_ID_READY_FILE
+};
+
+#define DAEMON_LONG_OPTS                                                      \
+  {"rt-prio",     required_argument, 0, DAEMON_OPT_ID_RT_PRIO},               \
+  {"cpu",         required_argument, 0, DAEMON_OPT_ID_CPU},                   \
+  {"mlockall",    no_argument,       0, DAEMON_OPT_ID_MLOCKALL},             \
+  {"ready-file",  required_argument, 0, DAEMON_OPT_ID_READY_FILE}
+
+/* Print the usage of the shared options */
+void daemon_usage(void);
+
+/* Handle an option not known to the daemon. Returns 0 on success, or -1
+ * if the option is not a shared option or its argument is invalid. */
+int daemon_option(int opt_id, const char *arg);
+
+/* Apply the CPU affinity and SCHED_FIFO priority, which are inherited by
+ * child processes */
+int daemon_sched_setup(void);
+
+/* Lock memory and pre-fault the stack if requested. Memory locks are not
+ * inherited across fork(), so children must call this again. */
+int daemon_memory_lock(void);
+
+/* Create the --ready-file, if given, to signal to the init scripts that
+ * startup is complete */
+void daemon_ready_notify(void);
+
+#endif /* SWIFTNAV_DAEMON_UTIL_H */
@@ -0,0 +1,20 @@
+################################################################################
+#
+# fw_loader
+#
+################################################################################
+
+FW_LOADER_VERSION = 0.1
+FW_LOADER_SITE = "${BR2_EXTERNAL}/package/fw_loader/src"
+FW_LOADER_SITE_METHOD = local
+FW_LOADER_DEPENDENCIES = zlib
+
+define FW_LOADER_BUILD_CMDS
+    $(MAKE) CC=$(TARGET_CC) LD=$(TARGET_LD) -C $(@D) all
+endef
+
+define FW_LOADER_INSTALL_TARGET_CMDS
+    $(INSTALL) -D -m 0755 $(@D)/fw_loader $(TARGET_DIR)/usr/bin
+endef
+
+$(eval $(generic-package))
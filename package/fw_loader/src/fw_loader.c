@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define FPGA_DEVICE_DEFAULT "/dev/xdevcfg"
+#define CHUNK_SIZE (64 * 1024)
+#define BUFFER_ALIGN 4096
+
+typedef enum {
+  MODE_INVALID,
+  MODE_FPGA,
+  MODE_INSTALL
+} load_mode_t;
+
+static bool debug = false;
+static load_mode_t mode = MODE_INVALID;
+static const char *fpga_device = FPGA_DEVICE_DEFAULT;
+static const char *source_path = NULL;
+static const char *dest_path = NULL;
+
+static void usage(char *command)
+{
+  printf("Usage: %s <mode> [options]\n", command);
+
+  puts("\nModes - select one");
+  puts("\t--fpga <bitstream>");
+  puts("\t\tstream a bitstream to the FPGA configuration device");
+  puts("\t--install <source> <dest>");
+  puts("\t\tcopy source to dest unless dest already has the same contents");
+
+  puts("\nMisc options");
+  puts("\t--device <dev>");
+  puts("\t\tFPGA configuration device, default " FPGA_DEVICE_DEFAULT);
+  puts("\t--debug");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_FPGA = 1,
+    OPT_ID_INSTALL,
+    OPT_ID_DEVICE,
+    OPT_ID_DEBUG
+  };
+
+  const struct option long_opts[] = {
+    {"fpga",    required_argument, 0, OPT_ID_FPGA},
+    {"install", required_argument, 0, OPT_ID_INSTALL},
+    {"device",  required_argument, 0, OPT_ID_DEVICE},
+    {"debug",   no_argument,       0, OPT_ID_DEBUG},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case OPT_ID_FPGA: {
+        mode = MODE_FPGA;
+        source_path = optarg;
+      }
+      break;
+
+      case OPT_ID_INSTALL: {
+        mode = MODE_INSTALL;
+        source_path = optarg;
+      }
+      break;
+
+      case OPT_ID_DEVICE: {
+        fpga_device = optarg;
+      }
+      break;
+
+      case OPT_ID_DEBUG: {
+        debug = true;
+      }
+      break;
+
+      default: {
+        printf("invalid option\n");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  if (mode == MODE_INVALID) {
+    printf("mode not specified\n");
+    return -1;
+  }
+
+  if (mode == MODE_INSTALL) {
+    if (optind >= argc) {
+      printf("destination not specified\n");
+      return -1;
+    }
+    dest_path = argv[optind];
+  }
+
+  return 0;
+}
+
+static uint64_t now_us(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static void phase_report(const char *phase, uint64_t start_us, size_t bytes)
+{
+  uint64_t elapsed_us = now_us() - start_us;
+  printf("%s: %llu ms", phase, (unsigned long long)(elapsed_us / 1000));
+  if (bytes > 0) {
+    printf(", %zu bytes", bytes);
+  }
+  printf("\n");
+}
+
+static ssize_t read_full(int fd, void *buffer, size_t count)
+{
+  size_t total = 0;
+  while (total < count) {
+    ssize_t n = read(fd, (uint8_t *)buffer + total, count - total);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += n;
+  }
+  return total;
+}
+
+static int write_full(int fd, const void *buffer, size_t count)
+{
+  size_t total = 0;
+  while (total < count) {
+    ssize_t n = write(fd, (const uint8_t *)buffer + total, count - total);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    total += n;
+  }
+  return 0;
+}
+
+/* Read a whole file into an aligned buffer */
+static int file_load(const char *path, uint8_t **data, size_t *size)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  void *buffer;
+  if (posix_memalign(&buffer, BUFFER_ALIGN, st.st_size + 1) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  ssize_t n = read_full(fd, buffer, st.st_size);
+  close(fd);
+  if (n != st.st_size) {
+    free(buffer);
+    return -1;
+  }
+
+  *data = buffer;
+  *size = n;
+  return 0;
+}
+
+/* Stream the bitstream in large aligned chunks. The kernel is asked to
+ * read ahead the whole file so that reading from the SD card overlaps
+ * with configuration. */
+static int fpga_load(void)
+{
+  uint64_t start_us = now_us();
+
+  int in_fd = open(source_path, O_RDONLY);
+  if (in_fd < 0) {
+    printf("error opening %s: %s\n", source_path, strerror(errno));
+    return -1;
+  }
+  posix_fadvise(in_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  posix_fadvise(in_fd, 0, 0, POSIX_FADV_WILLNEED);
+
+  int out_fd = open(fpga_device, O_WRONLY);
+  if (out_fd < 0) {
+    printf("error opening %s: %s\n", fpga_device, strerror(errno));
+    close(in_fd);
+    return -1;
+  }
+
+  void *buffer;
+  if (posix_memalign(&buffer, BUFFER_ALIGN, CHUNK_SIZE) != 0) {
+    close(out_fd);
+    close(in_fd);
+    return -1;
+  }
+
+  int ret = 0;
+  size_t total = 0;
+  while (1) {
+    ssize_t n = read_full(in_fd, buffer, CHUNK_SIZE);
+    if (n < 0) {
+      printf("error reading %s: %s\n", source_path, strerror(errno));
+      ret = -1;
+      break;
+    }
+    if (n == 0) {
+      break;
+    }
+    if (write_full(out_fd, buffer, n) != 0) {
+      printf("error writing %s: %s\n", fpga_device, strerror(errno));
+      ret = -1;
+      break;
+    }
+    total += n;
+  }
+
+  free(buffer);
+  close(in_fd);
+
+  /* Configuration completes when the device is closed */
+  if (close(out_fd) != 0) {
+    printf("error closing %s: %s\n", fpga_device, strerror(errno));
+    ret = -1;
+  }
+
+  phase_report("fpga", start_us, total);
+  return ret;
+}
+
+static int install(void)
+{
+  uint64_t start_us = now_us();
+
+  uint8_t *source;
+  size_t source_size;
+  if (file_load(source_path, &source, &source_size) != 0) {
+    printf("error reading %s: %s\n", source_path, strerror(errno));
+    return -1;
+  }
+  uLong source_crc = crc32(crc32(0L, Z_NULL, 0), source, source_size);
+  phase_report("read", start_us, source_size);
+
+  /* Files of different sizes are never read for comparison */
+  start_us = now_us();
+  struct stat st;
+  bool same = false;
+  if ((stat(dest_path, &st) == 0) && ((size_t)st.st_size == source_size)) {
+    uint8_t *dest;
+    size_t dest_size;
+    if (file_load(dest_path, &dest, &dest_size) == 0) {
+      same = (dest_size == source_size) &&
+             (crc32(crc32(0L, Z_NULL, 0), dest, dest_size) == source_crc);
+      free(dest);
+    }
+  }
+  phase_report("compare", start_us, 0);
+
+  if (same) {
+    printf("%s is up to date\n", dest_path);
+    free(source);
+    return 0;
+  }
+
+  /* Write a temporary file and rename it so that dest is never partial */
+  start_us = now_us();
+  char tmp_path[PATH_MAX];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", dest_path);
+  int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  int ret = 0;
+  if ((fd < 0) || (write_full(fd, source, source_size) != 0)) {
+    printf("error writing %s: %s\n", tmp_path, strerror(errno));
+    ret = -1;
+  }
+  if ((fd >= 0) && (close(fd) != 0)) {
+    ret = -1;
+  }
+  if ((ret == 0) && (rename(tmp_path, dest_path) != 0)) {
+    printf("error renaming %s: %s\n", tmp_path, strerror(errno));
+    ret = -1;
+  }
+  if (ret != 0) {
+    unlink(tmp_path);
+  }
+  phase_report("copy", start_us, source_size);
+
+  free(source);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  uint64_t start_us = now_us();
+  int ret = 0;
+
+  switch (mode) {
+    case MODE_FPGA: {
+      ret = fpga_load();
+    }
+    break;
+
+    case MODE_INSTALL: {
+      ret = install();
+    }
+    break;
+
+    default:
+      break;
+  }
+
+  if (debug) {
+    phase_report("total", start_us, 0);
+  }
+
+  return (ret == 0) ? 0 : 1;
+}
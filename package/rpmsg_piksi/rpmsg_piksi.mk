@@ -7,6 +7,11 @@
 RPMSG_PIKSI_VERSION = 0.1
 RPMSG_PIKSI_SITE = "${BR2_EXTERNAL}/package/rpmsg_piksi/src"
 RPMSG_PIKSI_SITE_METHOD = local
+RPMSG_PIKSI_INSTALL_STAGING = YES
+
+define RPMSG_PIKSI_INSTALL_STAGING_CMDS
+    $(INSTALL) -D -m 0644 $(@D)/rpmsg_piksi.h $(STAGING_DIR)/usr/include/rpmsg_piksi.h
+endef
 
 $(eval $(kernel-module))
 $(eval $(generic-package))
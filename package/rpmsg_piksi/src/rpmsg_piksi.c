@@ -25,6 +25,10 @@
 #include <linux/ioctl.h>
 #include <linux/errno.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+
+#include "rpmsg_piksi.h"
 
 /* rpmsg_piksi driver
  * - character devices are created on module init
@@ -32,6 +36,9 @@
  * - if rpmsg is not attached:
  *     - character device reads block
  *     - character device writes silently drop data
+ * - with IOCTL_CMD_SET_RX_TIMESTAMP enabled, each read returns one record
+ *   prefixed with struct rx_header holding the arrival time, and messages
+ *   larger than RPMSG_BUFF_SIZE_MAX are dropped
  */
 
 #define DEV_CLASS_NAME "rpmsg_piksi"
@@ -42,10 +49,6 @@
 #define RX_FIFO_SIZE (32 * RPMSG_BUFF_SIZE_MAX)
 #define TX_BUFF_SIZE (RPMSG_BUFF_SIZE_MAX)
 
-#define IOCTL_CMD_GET_KFIFO_SIZE      1
-#define IOCTL_CMD_GET_AVAIL_DATA_SIZE 2
-#define IOCTL_CMD_GET_FREE_BUFF_SIZE  3
-
 static const u32 endpoint_addr_config[NUM_ENDPOINTS] = {
   100,
   101,
@@ -61,6 +64,11 @@ struct ept_params {
   struct mutex rx_fifo_lock;
   wait_queue_head_t rx_wait_queue;
   STRUCT_KFIFO_REC_2(RX_FIFO_SIZE) rx_fifo;
+  /* spinlock used to protect rx_timestamp and rx_stage against the rpmsg
+   * callback, and rx_fifo while it is reset */
+  spinlock_t rx_stage_lock;
+  bool rx_timestamp;
+  char rx_stage[sizeof(struct rx_header) + RPMSG_BUFF_SIZE_MAX];
   /* mutex used to protect tx_buff and rpmsg parameters */
   struct mutex tx_rpmsg_lock;
   char tx_buff[TX_BUFF_SIZE];
@@ -228,6 +236,28 @@ static long ept_cdev_ioctl(struct file *p_file, unsigned int cmd,
     }
     break;
 
+    case IOCTL_CMD_SET_RX_TIMESTAMP: {
+      unsigned long flags;
+      int retval;
+
+      /* Acquire RX lock so that no read is in progress */
+      retval = mutex_lock_interruptible(&ept_params->rx_fifo_lock);
+      if (retval) {
+        return retval;
+      }
+
+      /* Records in the FIFO must all be of the same form */
+      spin_lock_irqsave(&ept_params->rx_stage_lock, flags);
+      if (ept_params->rx_timestamp != (arg != 0)) {
+        ept_params->rx_timestamp = (arg != 0);
+        kfifo_reset(&ept_params->rx_fifo);
+      }
+      spin_unlock_irqrestore(&ept_params->rx_stage_lock, flags);
+
+      mutex_unlock(&ept_params->rx_fifo_lock);
+    }
+    break;
+
     default: {
       return -EINVAL;
     }
@@ -261,7 +291,10 @@ static void ept_rpmsg_cb(struct rpmsg_channel *rpdev, void *data,
                          int len, void *priv, u32 src)
 {
   struct ept_params *ept_params = priv;
-  int len_in;
+  u64 timestamp_ns = ktime_get_ns();
+  struct rx_header header;
+  unsigned long flags;
+  unsigned int len_in;
 
   /* Do not write zero-length records to the FIFO, as this would
    * cause read() to return zero, aka EOF */
@@ -270,8 +303,25 @@ static void ept_rpmsg_cb(struct rpmsg_channel *rpdev, void *data,
     return;
   }
 
-  len_in = kfifo_in(&ept_params->rx_fifo, data, (unsigned int)len);
-  if (len_in != len) {
+  spin_lock_irqsave(&ept_params->rx_stage_lock, flags);
+  if (ept_params->rx_timestamp && (len > RPMSG_BUFF_SIZE_MAX)) {
+    /* Does not fit in rx_stage */
+    spin_unlock_irqrestore(&ept_params->rx_stage_lock, flags);
+    dev_info(&rpdev->dev, "Dropping oversized message.\n");
+    return;
+  } else if (ept_params->rx_timestamp) {
+    /* Stage the header and data so that they form a single record */
+    header.timestamp_ns = timestamp_ns;
+    memcpy(ept_params->rx_stage, &header, sizeof(header));
+    memcpy(&ept_params->rx_stage[sizeof(header)], data, len);
+    len_in = kfifo_in(&ept_params->rx_fifo, ept_params->rx_stage,
+                      sizeof(header) + len);
+  } else {
+    len_in = kfifo_in(&ept_params->rx_fifo, data, (unsigned int)len);
+  }
+  spin_unlock_irqrestore(&ept_params->rx_stage_lock, flags);
+
+  if (len_in == 0) {
     /* There was no space for incoming data */
     return;
   }
@@ -343,10 +393,12 @@ static int ept_cdev_setup(struct ept_params *ept_params, dev_t dev, u32 addr)
   ept_params->dev = dev;
   ept_params->addr = addr;
   ept_params->rpmsg_ready = false;
+  ept_params->rx_timestamp = false;
 
-  /* Initialize mutexes */
+  /* Initialize locks */
   mutex_init(&ept_params->rx_fifo_lock);
   mutex_init(&ept_params->tx_rpmsg_lock);
+  spin_lock_init(&ept_params->rx_stage_lock);
 
   /* Initialize wait queue head that provides blocking RX for userspace */
   init_waitqueue_head(&ept_params->rx_wait_queue);
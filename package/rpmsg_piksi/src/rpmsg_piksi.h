@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_RPMSG_PIKSI_H
+#define SWIFTNAV_RPMSG_PIKSI_H
+
+/* Userspace interface of the rpmsg_piksi character devices */
+
+#include <linux/types.h>
+
+#define IOCTL_CMD_GET_KFIFO_SIZE      1
+#define IOCTL_CMD_GET_AVAIL_DATA_SIZE 2
+#define IOCTL_CMD_GET_FREE_BUFF_SIZE  3
+/* arg is 0 or 1, queued data is discarded when the mode changes */
+#define IOCTL_CMD_SET_RX_TIMESTAMP    4
+
+/* Prefixed to received data when timestamping is enabled */
+struct rx_header {
+  /* ktime_get_ns() (CLOCK_MONOTONIC) when the message was received */
+  __u64 timestamp_ns;
+} __attribute__((packed));
+
+#endif /* SWIFTNAV_RPMSG_PIKSI_H */
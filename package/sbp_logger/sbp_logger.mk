@@ -0,0 +1,22 @@
+################################################################################
+#
+# sbp_logger
+#
+################################################################################
+
+SBP_LOGGER_VERSION = 0.1
+SBP_LOGGER_SITE = "${BR2_EXTERNAL}/package/sbp_logger/src"
+SBP_LOGGER_SITE_METHOD = local
+SBP_LOGGER_DEPENDENCIES = czmq lz4
+
+define SBP_LOGGER_BUILD_CMDS
+    $(MAKE) CC=$(TARGET_CC) LD=$(TARGET_LD) -C $(@D) all
+endef
+
+define SBP_LOGGER_INSTALL_TARGET_CMDS
+    $(INSTALL) -D -m 0755 $(@D)/sbp_logger $(TARGET_DIR)/usr/bin
+    $(INSTALL) -D -m 0755 $(@D)/sbp_log_extract $(TARGET_DIR)/usr/bin
+    $(INSTALL) -D -m 0755 $(@D)/sbp_log_replay $(TARGET_DIR)/usr/bin
+endef
+
+$(eval $(generic-package))
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_LOG_FORMAT_H
+#define SWIFTNAV_LOG_FORMAT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Block log file layout (all fields little endian):
+ *
+ *   log_file_header_t
+ *   (padding up to data_offset)
+ *   repeated:
+ *     log_block_header_t
+ *     block data, LZ4 compressed if LOG_BLOCK_FLAG_LZ4 is set
+ *     (padding up to stored_size)
+ *   log_index_entry_t[entry_count]
+ *   log_index_trailer_t
+ *
+ * Uncompressed block data is a sequence of log_record_header_t, each
+ * followed by one SBP frame. The index is only written when a file is
+ * closed. If it is missing the blocks can be found by walking the block
+ * headers from data_offset.
+ */
+
+#define LOG_FILE_MAGIC  0x4c504253 /* "SBPL" */
+#define LOG_BLOCK_MAGIC 0x42504253 /* "SBPB" */
+#define LOG_INDEX_MAGIC 0x49504253 /* "SBPI" */
+#define LOG_FORMAT_VERSION 1
+
+#define LOG_BLOCK_SIZE_MAX (64 * 1024)
+#define LOG_BLOCK_FLAG_LZ4 0x0001
+
+#define LOG_MSG_TYPE_BITMAP_SIZE 32
+
+#define SBP_PREAMBLE 0x55
+#define SBP_HEADER_LEN 6
+#define SBP_MSG_GPS_TIME 0x0100
+
+#define GPS_WEEK_ms (7ULL * 24 * 60 * 60 * 1000)
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t data_offset;
+} log_file_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint16_t flags;
+  uint16_t reserved;
+  uint32_t stored_size;
+  uint32_t data_size;
+  uint32_t uncompressed_size;
+  uint32_t record_count;
+  uint64_t rx_time_start_ms;
+  uint64_t rx_time_end_ms;
+  /* GPS time in ms since the GPS epoch, 0 if not known */
+  uint64_t gps_time_start_ms;
+  uint64_t gps_time_end_ms;
+  uint8_t msg_type_bitmap[LOG_MSG_TYPE_BITMAP_SIZE];
+} log_block_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint64_t offset;
+  log_block_header_t header;
+} log_index_entry_t;
+
+typedef struct __attribute__((packed)) {
+  uint64_t index_offset;
+  uint32_t entry_count;
+  uint32_t magic;
+} log_index_trailer_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t rx_time_offset_ms;
+  uint16_t length;
+} log_record_header_t;
+
+/* The msg_type bitmap is a hash: a set bit means the block may contain
+ * a given msg_type, a clear bit means it definitely does not */
+static inline uint8_t log_msg_type_bit(uint16_t msg_type)
+{
+  return (msg_type ^ (msg_type >> 8)) & 0xff;
+}
+
+static inline void log_msg_type_bitmap_set(uint8_t *bitmap, uint16_t msg_type)
+{
+  uint8_t bit = log_msg_type_bit(msg_type);
+  bitmap[bit / 8] |= (1 << (bit % 8));
+}
+
+static inline bool log_msg_type_bitmap_test(const uint8_t *bitmap,
+                                            uint16_t msg_type)
+{
+  uint8_t bit = log_msg_type_bit(msg_type);
+  return (bitmap[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+static inline bool sbp_frame_msg_type(const uint8_t *frame, size_t length,
+                                      uint16_t *msg_type)
+{
+  if ((length < SBP_HEADER_LEN) || (frame[0] != SBP_PREAMBLE)) {
+    return false;
+  }
+
+  *msg_type = frame[1] | (frame[2] << 8);
+  return true;
+}
+
+static inline bool sbp_frame_gps_time(const uint8_t *frame, size_t length,
+                                      uint64_t *gps_time_ms)
+{
+  uint16_t msg_type;
+  if (!sbp_frame_msg_type(frame, length, &msg_type) ||
+      (msg_type != SBP_MSG_GPS_TIME)) {
+    return false;
+  }
+
+  /* MSG_GPS_TIME payload begins with u16 wn, u32 tow (ms) */
+  const uint8_t *payload = &frame[SBP_HEADER_LEN];
+  if ((frame[5] < 6) || (length < SBP_HEADER_LEN + 6)) {
+    return false;
+  }
+
+  uint16_t wn = payload[0] | (payload[1] << 8);
+  uint32_t tow = payload[2] | (payload[3] << 8) |
+                 (payload[4] << 16) | ((uint32_t)payload[5] << 24);
+  *gps_time_ms = wn * GPS_WEEK_ms + tow;
+  return true;
+}
+
+#endif /* SWIFTNAV_LOG_FORMAT_H */
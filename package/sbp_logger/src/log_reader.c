@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "log_reader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <lz4.h>
+
+struct log_reader_s {
+  int fd;
+  uint64_t file_size;
+  log_index_entry_t *index;
+  uint32_t index_count;
+  bool index_recovered;
+  uint8_t *block_data;
+};
+
+static bool read_exact(int fd, void *data, size_t length, uint64_t offset)
+{
+  size_t done = 0;
+  while (done < length) {
+    ssize_t ret = pread(fd, &((uint8_t *)data)[done], length - done,
+                        offset + done);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (ret == 0) {
+      return false;
+    }
+    done += ret;
+  }
+  return true;
+}
+
+static bool block_header_valid(const log_block_header_t *header)
+{
+  return (header->magic == LOG_BLOCK_MAGIC) &&
+         (header->uncompressed_size <= LOG_BLOCK_SIZE_MAX) &&
+         (header->data_size <= header->stored_size) &&
+         (header->data_size <= LOG_BLOCK_SIZE_MAX);
+}
+
+static int index_load(log_reader_t *r)
+{
+  log_index_trailer_t trailer;
+  if ((r->file_size < sizeof(trailer)) ||
+      !read_exact(r->fd, &trailer, sizeof(trailer),
+                  r->file_size - sizeof(trailer))) {
+    return -1;
+  }
+
+  uint64_t index_length = (uint64_t)trailer.entry_count *
+                          sizeof(log_index_entry_t);
+  if ((trailer.magic != LOG_INDEX_MAGIC) ||
+      (trailer.index_offset + index_length + sizeof(trailer) !=
+       r->file_size)) {
+    return -1;
+  }
+
+  r->index = malloc(index_length + 1);
+  if (r->index == NULL) {
+    return -1;
+  }
+
+  if (!read_exact(r->fd, r->index, index_length, trailer.index_offset)) {
+    return -1;
+  }
+
+  r->index_count = trailer.entry_count;
+  return 0;
+}
+
+static int index_scan(log_reader_t *r, uint64_t offset)
+{
+  uint32_t capacity = 0;
+  r->index_count = 0;
+
+  /* Stop at the first invalid or truncated block. Anything after it was
+   * not completely written. */
+  log_block_header_t header;
+  while (read_exact(r->fd, &header, sizeof(header), offset) &&
+         block_header_valid(&header) &&
+         (offset + sizeof(header) + header.stored_size <= r->file_size)) {
+
+    if (r->index_count == capacity) {
+      capacity = (capacity > 0) ? 2 * capacity : 64;
+      log_index_entry_t *index = realloc(r->index, capacity * sizeof(*index));
+      if (index == NULL) {
+        return -1;
+      }
+      r->index = index;
+    }
+
+    r->index[r->index_count++] = (log_index_entry_t) {
+      .offset = offset,
+      .header = header
+    };
+    offset += sizeof(header) + header.stored_size;
+  }
+
+  r->index_recovered = true;
+  return 0;
+}
+
+log_reader_t * log_reader_open(const char *path)
+{
+  log_reader_t *r = calloc(1, sizeof(*r));
+  if (r == NULL) {
+    return NULL;
+  }
+
+  r->fd = open(path, O_RDONLY);
+  if (r->fd < 0) {
+    fprintf(stderr, "error opening %s: %s\n", path, strerror(errno));
+    free(r);
+    return NULL;
+  }
+
+  struct stat st;
+  log_file_header_t file_header;
+  if ((fstat(r->fd, &st) != 0) ||
+      !read_exact(r->fd, &file_header, sizeof(file_header), 0) ||
+      (file_header.magic != LOG_FILE_MAGIC) ||
+      (file_header.version != LOG_FORMAT_VERSION)) {
+    fprintf(stderr, "%s is not a block format log\n", path);
+    goto err;
+  }
+  r->file_size = st.st_size;
+
+  r->block_data = malloc(LOG_BLOCK_SIZE_MAX);
+  if (r->block_data == NULL) {
+    goto err;
+  }
+
+  if (index_load(r) != 0) {
+    free(r->index);
+    r->index = NULL;
+    if (index_scan(r, file_header.data_offset) != 0) {
+      goto err;
+    }
+  }
+
+  return r;
+
+err:
+  close(r->fd);
+  free(r->index);
+  free(r->block_data);
+  free(r);
+  return NULL;
+}
+
+void log_reader_close(log_reader_t **reader)
+{
+  log_reader_t *r = *reader;
+  close(r->fd);
+  free(r->index);
+  free(r->block_data);
+  free(r);
+  *reader = NULL;
+}
+
+bool log_reader_index_recovered(const log_reader_t *r)
+{
+  return r->index_recovered;
+}
+
+uint32_t log_reader_block_count(const log_reader_t *r)
+{
+  return r->index_count;
+}
+
+const log_index_entry_t * log_reader_block(const log_reader_t *r,
+                                           uint32_t index)
+{
+  return (index < r->index_count) ? &r->index[index] : NULL;
+}
+
+int log_reader_block_read(log_reader_t *r, uint32_t index, uint8_t *buffer)
+{
+  const log_index_entry_t *entry = log_reader_block(r, index);
+  if ((entry == NULL) || !block_header_valid(&entry->header)) {
+    return -1;
+  }
+
+  const log_block_header_t *header = &entry->header;
+  uint64_t data_offset = entry->offset + sizeof(log_block_header_t);
+
+  if (!(header->flags & LOG_BLOCK_FLAG_LZ4)) {
+    if (!read_exact(r->fd, buffer, header->data_size, data_offset)) {
+      return -1;
+    }
+    return header->data_size;
+  }
+
+  if (!read_exact(r->fd, r->block_data, header->data_size, data_offset)) {
+    return -1;
+  }
+
+  int length = LZ4_decompress_safe((const char *)r->block_data,
+                                   (char *)buffer, header->data_size,
+                                   LOG_BLOCK_SIZE_MAX);
+  if (length != (int)header->uncompressed_size) {
+    return -1;
+  }
+
+  return length;
+}
+
+bool log_reader_record_next(const log_index_entry_t *block,
+                            const uint8_t *buffer, size_t length,
+                            size_t *offset, log_record_t *record)
+{
+  log_record_header_t record_header;
+  if (*offset + sizeof(record_header) > length) {
+    return false;
+  }
+
+  memcpy(&record_header, &buffer[*offset], sizeof(record_header));
+  size_t data_offset = *offset + sizeof(record_header);
+  if (data_offset + record_header.length > length) {
+    return false;
+  }
+
+  record->rx_time_ms = block->header.rx_time_start_ms +
+                       record_header.rx_time_offset_ms;
+  record->data = &buffer[data_offset];
+  record->length = record_header.length;
+  *offset = data_offset + record_header.length;
+  return true;
+}
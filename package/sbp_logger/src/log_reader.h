@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_LOG_READER_H
+#define SWIFTNAV_LOG_READER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "log_format.h"
+
+typedef struct log_reader_s log_reader_t;
+
+typedef struct {
+  uint64_t rx_time_ms;
+  const uint8_t *data;
+  uint16_t length;
+} log_record_t;
+
+log_reader_t * log_reader_open(const char *path);
+void log_reader_close(log_reader_t **reader);
+
+/* True if the index was rebuilt from block headers, e.g. after power loss */
+bool log_reader_index_recovered(const log_reader_t *reader);
+
+uint32_t log_reader_block_count(const log_reader_t *reader);
+const log_index_entry_t * log_reader_block(const log_reader_t *reader,
+                                           uint32_t index);
+
+/* Decompress a block into buffer, which must hold LOG_BLOCK_SIZE_MAX bytes.
+ * Returns the uncompressed length or -1 on error. */
+int log_reader_block_read(log_reader_t *reader, uint32_t index,
+                          uint8_t *buffer);
+
+/* Step through the records of a decompressed block. offset starts at 0. */
+bool log_reader_record_next(const log_index_entry_t *block,
+                            const uint8_t *buffer, size_t length,
+                            size_t *offset, log_record_t *record);
+
+#endif /* SWIFTNAV_LOG_READER_H */
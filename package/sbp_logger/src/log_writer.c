@@ -0,0 +1,604 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* O_DIRECT, fallocate() */
+#endif
+
+#include "log_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <lz4.h>
+
+#include "log_format.h"
+
+/* Buffers are submitted to the writer thread whole so that every write is
+ * large and aligned, as required for O_DIRECT */
+#define BUFFER_SIZE LOG_BLOCK_SIZE_MAX
+#define BUFFER_ALIGN 4096
+#define FILENAME_LEN_MAX 256
+/* Largest file on a FAT32 card */
+#define FILE_SIZE_MAX 0xffffffffULL
+
+#define ALIGN_UP(x) (((x) + BUFFER_ALIGN - 1) & ~(BUFFER_ALIGN - 1))
+#define BLOCK_BUFFER_SIZE \
+  ALIGN_UP(sizeof(log_block_header_t) + LZ4_COMPRESSBOUND(BUFFER_SIZE))
+
+typedef struct {
+  uint8_t *data;
+  size_t length;
+  /* Block format only, filled in as records are appended */
+  log_block_header_t header;
+} buffer_t;
+
+struct log_writer_s {
+  log_writer_config_t config;
+
+  /* Buffer pool, protected by lock */
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  buffer_t *free_list;
+  uint32_t free_count;
+  buffer_t *full_queue;
+  uint32_t full_head;
+  uint32_t full_count;
+  uint64_t dropped_bytes;
+  bool stop;
+
+  /* Producer state */
+  buffer_t current;
+  uint64_t gps_time_ms;
+
+  /* Writer thread state */
+  pthread_t thread;
+  int fd;
+  uint64_t file_offset;
+  uint64_t file_length;
+  time_t file_open_time;
+  bool open_error_reported;
+  bool write_error;
+  uint8_t *block_buffer;
+  log_index_entry_t *index;
+  uint32_t index_count;
+  uint32_t index_capacity;
+  /* An entry was lost, so no index is written for this file */
+  bool index_error;
+};
+
+static size_t write_length(const log_writer_t *w, size_t length)
+{
+  /* O_DIRECT requires whole blocks */
+  return w->config.direct_io ? ALIGN_UP(length) : length;
+}
+
+/* data must have room for padding up to write_length(length) */
+static int file_write(log_writer_t *w, uint8_t *data, size_t length)
+{
+  size_t padded_length = write_length(w, length);
+  memset(&data[length], 0, padded_length - length);
+
+  size_t offset = 0;
+  while (offset < padded_length) {
+    ssize_t ret = write(w->fd, &data[offset], padded_length - offset);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      printf("error writing log file: %s\n", strerror(errno));
+      w->write_error = true;
+      return -1;
+    }
+    offset += ret;
+  }
+
+  w->file_length = w->file_offset + length;
+  w->file_offset += padded_length;
+  return 0;
+}
+
+static int file_header_write(log_writer_t *w)
+{
+  log_file_header_t header = {
+    .magic = LOG_FILE_MAGIC,
+    .version = LOG_FORMAT_VERSION,
+    .flags = 0,
+    .data_offset = write_length(w, sizeof(log_file_header_t))
+  };
+
+  memcpy(w->block_buffer, &header, sizeof(header));
+  return file_write(w, w->block_buffer, sizeof(header));
+}
+
+static void index_append(log_writer_t *w, uint64_t offset,
+                         const log_block_header_t *header)
+{
+  if (w->index_error) {
+    return;
+  }
+
+  if (w->index_count == w->index_capacity) {
+    uint32_t capacity = (w->index_capacity > 0) ? 2 * w->index_capacity : 64;
+    log_index_entry_t *index = realloc(w->index, capacity * sizeof(*index));
+    if (index == NULL) {
+      /* An incomplete index would hide blocks from readers. Without one
+       * they fall back to scanning block headers. */
+      printf("error allocating log index\n");
+      w->index_error = true;
+      return;
+    }
+    w->index = index;
+    w->index_capacity = capacity;
+  }
+
+  w->index[w->index_count++] = (log_index_entry_t) {
+    .offset = offset,
+    .header = *header
+  };
+}
+
+static void index_write(log_writer_t *w)
+{
+  size_t index_length = w->index_count * sizeof(log_index_entry_t);
+  size_t length = index_length + sizeof(log_index_trailer_t);
+
+  uint8_t *data;
+  if (posix_memalign((void **)&data, BUFFER_ALIGN, ALIGN_UP(length)) != 0) {
+    return;
+  }
+
+  log_index_trailer_t trailer = {
+    .index_offset = w->file_offset,
+    .entry_count = w->index_count,
+    .magic = LOG_INDEX_MAGIC
+  };
+  memcpy(data, w->index, index_length);
+  memcpy(&data[index_length], &trailer, sizeof(trailer));
+
+  file_write(w, data, length);
+  free(data);
+}
+
+static int file_open(log_writer_t *w)
+{
+  /* Create the log directory if the card is mounted */
+  mkdir(w->config.dir, 0755);
+
+  time_t now = time(NULL);
+  struct tm tm;
+  gmtime_r(&now, &tm);
+  char timestamp[32];
+  strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", &tm);
+
+  const char *extension =
+      (w->config.format == LOG_FORMAT_BLOCK) ? "sbpl" : "sbp";
+
+  int flags = O_WRONLY | O_CREAT | O_EXCL;
+  if (w->config.direct_io) {
+    flags |= O_DIRECT;
+  }
+
+  /* Never overwrite an existing log */
+  int fd = -1;
+  for (int i=0; (fd < 0) && (i < 100); i++) {
+    char filename[FILENAME_LEN_MAX];
+    if (i == 0) {
+      snprintf(filename, sizeof(filename), "%s/sbp_%s.%s",
+               w->config.dir, timestamp, extension);
+    } else {
+      snprintf(filename, sizeof(filename), "%s/sbp_%s_%d.%s",
+               w->config.dir, timestamp, i, extension);
+    }
+
+    fd = open(filename, flags, 0644);
+    if ((fd < 0) && (errno != EEXIST)) {
+      break;
+    }
+  }
+
+  if (fd < 0) {
+    if (!w->open_error_reported) {
+      printf("error opening log file in %s: %s\n",
+             w->config.dir, strerror(errno));
+      w->open_error_reported = true;
+    }
+    return -1;
+  }
+
+  /* Reserve space up front so that the file is contiguous and block
+   * allocation does not stall writes. Not all filesystems support this. */
+  if (w->config.rotate_size > 0) {
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)w->config.rotate_size);
+  }
+
+  w->fd = fd;
+  w->file_offset = 0;
+  w->file_length = 0;
+  w->file_open_time = now;
+  w->open_error_reported = false;
+  w->write_error = false;
+  w->index_count = 0;
+  w->index_error = false;
+
+  if ((w->config.format == LOG_FORMAT_BLOCK) && (file_header_write(w) != 0)) {
+    close(w->fd);
+    w->fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void file_close(log_writer_t *w)
+{
+  if (w->fd < 0) {
+    return;
+  }
+
+  if ((w->config.format == LOG_FORMAT_BLOCK) && !w->write_error &&
+      !w->index_error) {
+    index_write(w);
+  }
+
+  /* Drop any O_DIRECT padding from the end of the file along with
+   * unused preallocated space */
+  ftruncate(w->fd, w->file_length);
+  fdatasync(w->fd);
+  close(w->fd);
+  w->fd = -1;
+}
+
+static bool file_rotate_required(const log_writer_t *w)
+{
+  if ((w->config.rotate_size > 0) &&
+      (w->file_offset >= w->config.rotate_size)) {
+    return true;
+  }
+
+  /* The next block and the index written on close must still fit in the
+   * file, whatever the rotation settings */
+  uint64_t index_length = (w->index_count + 1) * sizeof(log_index_entry_t) +
+                          sizeof(log_index_trailer_t);
+  if (w->file_offset + BLOCK_BUFFER_SIZE + ALIGN_UP(index_length) >
+      FILE_SIZE_MAX) {
+    return true;
+  }
+
+  if ((w->config.rotate_time_s > 0) &&
+      (time(NULL) - w->file_open_time >= w->config.rotate_time_s)) {
+    return true;
+  }
+
+  return false;
+}
+
+static void buffer_write(log_writer_t *w, buffer_t *buffer)
+{
+  if ((w->fd >= 0) && file_rotate_required(w)) {
+    file_close(w);
+  }
+
+  if ((w->fd < 0) && (file_open(w) != 0)) {
+    pthread_mutex_lock(&w->lock);
+    w->dropped_bytes += buffer->length;
+    pthread_mutex_unlock(&w->lock);
+    return;
+  }
+
+  if (w->config.format == LOG_FORMAT_RAW) {
+    /* O_DIRECT padding is zeros, which SBP parsers skip while searching
+     * for the next preamble */
+    if (file_write(w, buffer->data, buffer->length) != 0) {
+      file_close(w);
+    }
+    return;
+  }
+
+  log_block_header_t *header = (log_block_header_t *)w->block_buffer;
+  uint8_t *block_data = &w->block_buffer[sizeof(log_block_header_t)];
+
+  *header = buffer->header;
+  header->magic = LOG_BLOCK_MAGIC;
+  header->uncompressed_size = buffer->length;
+
+  int compressed_length = LZ4_compress_default((const char *)buffer->data,
+                                               (char *)block_data,
+                                               buffer->length,
+                                               LZ4_COMPRESSBOUND(BUFFER_SIZE));
+  if ((compressed_length > 0) &&
+      ((size_t)compressed_length < buffer->length)) {
+    header->flags = LOG_BLOCK_FLAG_LZ4;
+    header->data_size = compressed_length;
+  } else {
+    /* Incompressible, store as is */
+    header->flags = 0;
+    memcpy(block_data, buffer->data, buffer->length);
+    header->data_size = buffer->length;
+  }
+
+  size_t length = sizeof(log_block_header_t) + header->data_size;
+  header->stored_size = write_length(w, length) - sizeof(log_block_header_t);
+
+  uint64_t offset = w->file_offset;
+  if (file_write(w, w->block_buffer, length) != 0) {
+    file_close(w);
+    return;
+  }
+
+  index_append(w, offset, header);
+}
+
+static void * writer_thread(void *arg)
+{
+  log_writer_t *w = (log_writer_t *)arg;
+
+  pthread_mutex_lock(&w->lock);
+  while (1) {
+    while ((w->full_count == 0) && !w->stop) {
+      pthread_cond_wait(&w->cond, &w->lock);
+    }
+
+    if (w->full_count == 0) {
+      /* Stopped and drained */
+      break;
+    }
+
+    buffer_t buffer = w->full_queue[w->full_head];
+    w->full_head = (w->full_head + 1) % w->config.buffer_count;
+    w->full_count--;
+    pthread_mutex_unlock(&w->lock);
+
+    buffer_write(w, &buffer);
+
+    pthread_mutex_lock(&w->lock);
+    buffer.length = 0;
+    w->free_list[w->free_count++] = buffer;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  file_close(w);
+  return NULL;
+}
+
+static void buffer_submit(log_writer_t *w)
+{
+  pthread_mutex_lock(&w->lock);
+
+  if ((w->current.data != NULL) && (w->current.length > 0)) {
+    uint32_t tail = (w->full_head + w->full_count) % w->config.buffer_count;
+    w->full_queue[tail] = w->current;
+    w->full_count++;
+    w->current.data = NULL;
+    w->current.length = 0;
+    pthread_cond_signal(&w->cond);
+  }
+
+  /* Take a new buffer if one is free. If the card is too slow to keep up
+   * then none will be and incoming data is dropped, bounding memory use. */
+  if ((w->current.data == NULL) && (w->free_count > 0)) {
+    w->current = w->free_list[--w->free_count];
+    memset(&w->current.header, 0, sizeof(w->current.header));
+  }
+
+  pthread_mutex_unlock(&w->lock);
+}
+
+log_writer_t * log_writer_create(const log_writer_config_t *config)
+{
+  log_writer_t *w = calloc(1, sizeof(*w));
+  if (w == NULL) {
+    return NULL;
+  }
+
+  w->config = *config;
+  w->fd = -1;
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->cond, NULL);
+
+  w->free_list = calloc(config->buffer_count, sizeof(buffer_t));
+  w->full_queue = calloc(config->buffer_count, sizeof(buffer_t));
+  if ((w->free_list == NULL) || (w->full_queue == NULL)) {
+    goto err;
+  }
+
+  if (config->format == LOG_FORMAT_BLOCK) {
+    if (posix_memalign((void **)&w->block_buffer, BUFFER_ALIGN,
+                       BLOCK_BUFFER_SIZE) != 0) {
+      w->block_buffer = NULL;
+      goto err;
+    }
+  }
+
+  for (uint32_t i=0; i<config->buffer_count; i++) {
+    void *data;
+    if (posix_memalign(&data, BUFFER_ALIGN, BUFFER_SIZE) != 0) {
+      goto err;
+    }
+    w->free_list[w->free_count++] = (buffer_t) { .data = data };
+  }
+
+  w->current = w->free_list[--w->free_count];
+
+  if (pthread_create(&w->thread, NULL, writer_thread, w) != 0) {
+    goto err;
+  }
+
+  return w;
+
+err:
+  if (w->current.data != NULL) {
+    free(w->current.data);
+  }
+  for (uint32_t i=0; i<w->free_count; i++) {
+    free(w->free_list[i].data);
+  }
+  free(w->free_list);
+  free(w->full_queue);
+  free(w->block_buffer);
+  free(w);
+  return NULL;
+}
+
+void log_writer_destroy(log_writer_t **writer)
+{
+  log_writer_t *w = *writer;
+
+  buffer_submit(w);
+
+  pthread_mutex_lock(&w->lock);
+  w->stop = true;
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+
+  if (w->current.data != NULL) {
+    free(w->current.data);
+  }
+  for (uint32_t i=0; i<w->free_count; i++) {
+    free(w->free_list[i].data);
+  }
+  free(w->free_list);
+  free(w->full_queue);
+  free(w->block_buffer);
+  free(w->index);
+  pthread_mutex_destroy(&w->lock);
+  pthread_cond_destroy(&w->cond);
+  free(w);
+  *writer = NULL;
+}
+
+static void dropped_bytes_add(log_writer_t *w, size_t length)
+{
+  pthread_mutex_lock(&w->lock);
+  w->dropped_bytes += length;
+  pthread_mutex_unlock(&w->lock);
+}
+
+static void record_append(log_writer_t *w, uint64_t rx_time_ms,
+                          const uint8_t *data, size_t length)
+{
+  size_t record_length = sizeof(log_record_header_t) + length;
+  if (record_length > BUFFER_SIZE) {
+    dropped_bytes_add(w, length);
+    return;
+  }
+
+  /* Records never span blocks so that each block decodes on its own.
+   * Receive times are stored as 32-bit offsets from the block start. */
+  log_block_header_t *header = &w->current.header;
+  if ((w->current.data != NULL) &&
+      ((BUFFER_SIZE - w->current.length < record_length) ||
+       ((header->record_count > 0) &&
+        (rx_time_ms - header->rx_time_start_ms > UINT32_MAX)))) {
+    buffer_submit(w);
+  }
+
+  if (w->current.data == NULL) {
+    buffer_submit(w);
+    if (w->current.data == NULL) {
+      dropped_bytes_add(w, length);
+      return;
+    }
+  }
+
+  uint64_t gps_time_ms;
+  if (sbp_frame_gps_time(data, length, &gps_time_ms)) {
+    w->gps_time_ms = gps_time_ms;
+  }
+
+  if (header->record_count == 0) {
+    header->rx_time_start_ms = rx_time_ms;
+    header->gps_time_start_ms = w->gps_time_ms;
+  } else if (header->gps_time_start_ms == 0) {
+    header->gps_time_start_ms = w->gps_time_ms;
+  }
+
+  /* The wall clock may step backwards */
+  if (rx_time_ms < header->rx_time_start_ms) {
+    rx_time_ms = header->rx_time_start_ms;
+  }
+  if (rx_time_ms > header->rx_time_end_ms) {
+    header->rx_time_end_ms = rx_time_ms;
+  }
+  header->gps_time_end_ms = w->gps_time_ms;
+  header->record_count++;
+
+  uint16_t msg_type;
+  if (sbp_frame_msg_type(data, length, &msg_type)) {
+    log_msg_type_bitmap_set(header->msg_type_bitmap, msg_type);
+  }
+
+  log_record_header_t record_header = {
+    .rx_time_offset_ms = rx_time_ms - header->rx_time_start_ms,
+    .length = length
+  };
+  memcpy(&w->current.data[w->current.length],
+         &record_header, sizeof(record_header));
+  memcpy(&w->current.data[w->current.length + sizeof(record_header)],
+         data, length);
+  w->current.length += record_length;
+}
+
+void log_writer_write(log_writer_t *w, uint64_t rx_time_ms,
+                      const void *data, size_t length)
+{
+  if (w->config.format == LOG_FORMAT_BLOCK) {
+    record_append(w, rx_time_ms, data, length);
+    return;
+  }
+
+  size_t offset = 0;
+  while (offset < length) {
+    if (w->current.data == NULL) {
+      buffer_submit(w);
+      if (w->current.data == NULL) {
+        dropped_bytes_add(w, length - offset);
+        return;
+      }
+    }
+
+    size_t copy_length = length - offset;
+    if (copy_length > BUFFER_SIZE - w->current.length) {
+      copy_length = BUFFER_SIZE - w->current.length;
+    }
+    memcpy(&w->current.data[w->current.length],
+           &((const uint8_t *)data)[offset], copy_length);
+    w->current.length += copy_length;
+    offset += copy_length;
+
+    if (w->current.length == BUFFER_SIZE) {
+      buffer_submit(w);
+    }
+  }
+}
+
+void log_writer_flush(log_writer_t *w)
+{
+  buffer_submit(w);
+}
+
+uint64_t log_writer_dropped_bytes(log_writer_t *w)
+{
+  pthread_mutex_lock(&w->lock);
+  uint64_t dropped_bytes = w->dropped_bytes;
+  pthread_mutex_unlock(&w->lock);
+  return dropped_bytes;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_LOG_WRITER_H
+#define SWIFTNAV_LOG_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+  LOG_FORMAT_RAW,
+  LOG_FORMAT_BLOCK
+} log_format_t;
+
+typedef struct {
+  const char *dir;
+  log_format_t format;
+  uint64_t rotate_size;
+  uint32_t rotate_time_s;
+  uint32_t buffer_count;
+  bool direct_io;
+} log_writer_config_t;
+
+typedef struct log_writer_s log_writer_t;
+
+log_writer_t * log_writer_create(const log_writer_config_t *config);
+void log_writer_destroy(log_writer_t **writer);
+void log_writer_write(log_writer_t *writer, uint64_t rx_time_ms,
+                      const void *data, size_t length);
+void log_writer_flush(log_writer_t *writer);
+uint64_t log_writer_dropped_bytes(log_writer_t *writer);
+
+#endif /* SWIFTNAV_LOG_WRITER_H */
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "log_reader.h"
+
+#define MSG_TYPES_MAX 64
+
+static const char *output_path = NULL;
+static uint64_t gps_time_from_ms = 0;
+static uint64_t gps_time_to_ms = UINT64_MAX;
+static bool time_window = false;
+static uint16_t msg_types[MSG_TYPES_MAX];
+static uint32_t msg_types_count = 0;
+static bool list = false;
+
+static void usage(char *command)
+{
+  fprintf(stderr, "Usage: %s [options] <log file>...\n", command);
+
+  fputs("\nFilter options\n", stderr);
+  fputs("\t--from <week>:<tow s>\n", stderr);
+  fputs("\t\tGPS time at which to start\n", stderr);
+  fputs("\t--to <week>:<tow s>\n", stderr);
+  fputs("\t\tGPS time at which to stop\n", stderr);
+  fputs("\t-t, --type <msg_type>\n", stderr);
+  fputs("\t\tonly extract messages of this type, may be repeated\n", stderr);
+
+  fputs("\nOutput options\n", stderr);
+  fputs("\t-o, --output <file>\n", stderr);
+  fputs("\t\twrite SBP to a file instead of stdout\n", stderr);
+  fputs("\t--list\n", stderr);
+  fputs("\t\tprint the block index instead of extracting\n", stderr);
+}
+
+static int gps_time_parse(const char *s, uint64_t *gps_time_ms)
+{
+  char *end;
+  unsigned long wn = strtoul(s, &end, 10);
+  if (*end != ':') {
+    return -1;
+  }
+
+  double tow_s = strtod(end + 1, &end);
+  if ((*end != '\0') || (tow_s < 0)) {
+    return -1;
+  }
+
+  *gps_time_ms = wn * GPS_WEEK_ms + (uint64_t)(tow_s * 1000.0);
+  return 0;
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_FROM = 1,
+    OPT_ID_TO,
+    OPT_ID_LIST
+  };
+
+  const struct option long_opts[] = {
+    {"from",    required_argument, 0, OPT_ID_FROM},
+    {"to",      required_argument, 0, OPT_ID_TO},
+    {"type",    required_argument, 0, 't'},
+    {"output",  required_argument, 0, 'o'},
+    {"list",    no_argument,       0, OPT_ID_LIST},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "t:o:",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case OPT_ID_FROM: {
+        if (gps_time_parse(optarg, &gps_time_from_ms) != 0) {
+          fprintf(stderr, "invalid GPS time\n");
+          return -1;
+        }
+        time_window = true;
+      }
+      break;
+
+      case OPT_ID_TO: {
+        if (gps_time_parse(optarg, &gps_time_to_ms) != 0) {
+          fprintf(stderr, "invalid GPS time\n");
+          return -1;
+        }
+        time_window = true;
+      }
+      break;
+
+      case 't': {
+        if (msg_types_count == MSG_TYPES_MAX) {
+          fprintf(stderr, "too many message types\n");
+          return -1;
+        }
+        msg_types[msg_types_count++] = strtoul(optarg, NULL, 0);
+      }
+      break;
+
+      case 'o': {
+        output_path = optarg;
+      }
+      break;
+
+      case OPT_ID_LIST: {
+        list = true;
+      }
+      break;
+
+      default: {
+        fprintf(stderr, "invalid option\n");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "log file not specified\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+static bool block_selected(const log_block_header_t *header)
+{
+  /* Records take the GPS time of the most recent MSG_GPS_TIME, so the
+   * block header range bounds every record in the block */
+  if (time_window && (header->gps_time_end_ms != 0)) {
+    if ((header->gps_time_end_ms < gps_time_from_ms) ||
+        (header->gps_time_start_ms >= gps_time_to_ms)) {
+      return false;
+    }
+  }
+
+  if (msg_types_count == 0) {
+    return true;
+  }
+
+  for (uint32_t i=0; i<msg_types_count; i++) {
+    if (log_msg_type_bitmap_test(header->msg_type_bitmap, msg_types[i])) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool record_selected(const log_record_t *record, uint64_t gps_time_ms)
+{
+  if (time_window &&
+      ((gps_time_ms == 0) || (gps_time_ms < gps_time_from_ms) ||
+       (gps_time_ms >= gps_time_to_ms))) {
+    return false;
+  }
+
+  if (msg_types_count == 0) {
+    return true;
+  }
+
+  uint16_t msg_type;
+  if (!sbp_frame_msg_type(record->data, record->length, &msg_type)) {
+    return false;
+  }
+
+  for (uint32_t i=0; i<msg_types_count; i++) {
+    if (msg_types[i] == msg_type) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void list_blocks(const char *path, log_reader_t *reader)
+{
+  printf("%s: %u blocks%s\n", path, log_reader_block_count(reader),
+         log_reader_index_recovered(reader) ? " (index recovered)" : "");
+
+  for (uint32_t i=0; i<log_reader_block_count(reader); i++) {
+    const log_block_header_t *header = &log_reader_block(reader, i)->header;
+    printf("%6u  %5u records  %6u -> %6u bytes  "
+           "gps %u:%.3f - %u:%.3f\n",
+           i, header->record_count,
+           header->uncompressed_size, header->data_size,
+           (unsigned int)(header->gps_time_start_ms / GPS_WEEK_ms),
+           (header->gps_time_start_ms % GPS_WEEK_ms) / 1000.0,
+           (unsigned int)(header->gps_time_end_ms / GPS_WEEK_ms),
+           (header->gps_time_end_ms % GPS_WEEK_ms) / 1000.0);
+  }
+}
+
+static int extract(log_reader_t *reader, FILE *output, uint8_t *buffer)
+{
+  for (uint32_t i=0; i<log_reader_block_count(reader); i++) {
+    const log_index_entry_t *block = log_reader_block(reader, i);
+    if (!block_selected(&block->header)) {
+      continue;
+    }
+
+    int length = log_reader_block_read(reader, i, buffer);
+    if (length < 0) {
+      fprintf(stderr, "block %u is corrupt, skipping\n", i);
+      continue;
+    }
+
+    uint64_t gps_time_ms = block->header.gps_time_start_ms;
+    size_t offset = 0;
+    log_record_t record;
+    while (log_reader_record_next(block, buffer, length, &offset, &record)) {
+      sbp_frame_gps_time(record.data, record.length, &gps_time_ms);
+
+      if (record_selected(&record, gps_time_ms)) {
+        if (fwrite(record.data, 1, record.length, output) != record.length) {
+          fprintf(stderr, "error writing output\n");
+          return -1;
+        }
+      }
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  FILE *output = stdout;
+  if (!list && (output_path != NULL)) {
+    output = fopen(output_path, "wb");
+    if (output == NULL) {
+      fprintf(stderr, "error opening %s\n", output_path);
+      exit(1);
+    }
+  }
+
+  uint8_t *buffer = malloc(LOG_BLOCK_SIZE_MAX);
+  if (buffer == NULL) {
+    exit(1);
+  }
+
+  int ret = 0;
+  for (int i=optind; i<argc; i++) {
+    log_reader_t *reader = log_reader_open(argv[i]);
+    if (reader == NULL) {
+      ret = 1;
+      continue;
+    }
+
+    if (list) {
+      list_blocks(argv[i], reader);
+    } else if (extract(reader, output, buffer) != 0) {
+      ret = 1;
+    }
+
+    log_reader_close(&reader);
+  }
+
+  free(buffer);
+  if (output != stdout) {
+    fclose(output);
+  }
+
+  return ret;
+}
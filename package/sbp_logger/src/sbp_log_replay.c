@@ -0,0 +1,368 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+#include <czmq.h>
+
+#include "log_reader.h"
+
+/* Gaps longer than this are treated as discontinuities, e.g. between
+ * rotated files, and replay continues immediately */
+#define TIMING_GAP_MAX_ms 10000
+
+/* Allow the PUB connection to complete before sending */
+#define CONNECT_DELAY_ms 100
+
+typedef enum {
+  TIMING_RX,
+  TIMING_GPS,
+  TIMING_NONE
+} timing_t;
+
+typedef enum {
+  SEEK_NONE,
+  SEEK_OFFSET,
+  SEEK_GPS
+} seek_t;
+
+static bool debug = false;
+static const char *zmq_pub_addr = NULL;
+static timing_t timing = TIMING_RX;
+static double rate = 1.0;
+static bool loop = false;
+static seek_t seek = SEEK_NONE;
+static uint64_t seek_ms = 0;
+
+/* Replay state */
+static bool seeking = false;
+static uint64_t seek_rx_time_ms = 0;
+static bool pacing_valid = false;
+static int64_t pacing_base_wall_ms = 0;
+static uint64_t pacing_base_log_ms = 0;
+static uint64_t pacing_last_log_ms = 0;
+static uint64_t records_sent = 0;
+
+static void debug_printf(const char *msg, ...)
+{
+  if (!debug) {
+    return;
+  }
+
+  va_list ap;
+  va_start(ap, msg);
+  vprintf(msg, ap);
+  va_end(ap);
+}
+
+static void usage(char *command)
+{
+  printf("Usage: %s [options] <log file>...\n", command);
+
+  puts("\nZMQ Mode");
+  puts("\t-p, --pub <addr>");
+  puts("\t\tsink socket, e.g. >tcp://127.0.0.1:43011");
+
+  puts("\nReplay options");
+  puts("\t--timing <rx|gps|none>");
+  puts("\t\tpace messages by receive time (default), by GPS time,");
+  puts("\t\tor send as fast as possible");
+  puts("\t--rate <factor>");
+  puts("\t\tplayback speed multiplier");
+  puts("\t--seek <s> | <week>:<tow s>");
+  puts("\t\tstart this many seconds into the log, or at a GPS time");
+  puts("\t--loop");
+  puts("\t\trestart from the seek point after the last file");
+
+  puts("\nMisc options");
+  puts("\t--debug");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_TIMING = 1,
+    OPT_ID_RATE,
+    OPT_ID_SEEK,
+    OPT_ID_LOOP,
+    OPT_ID_DEBUG
+  };
+
+  const struct option long_opts[] = {
+    {"pub",     required_argument, 0, 'p'},
+    {"timing",  required_argument, 0, OPT_ID_TIMING},
+    {"rate",    required_argument, 0, OPT_ID_RATE},
+    {"seek",    required_argument, 0, OPT_ID_SEEK},
+    {"loop",    no_argument,       0, OPT_ID_LOOP},
+    {"debug",   no_argument,       0, OPT_ID_DEBUG},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "p:",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case 'p': {
+        zmq_pub_addr = optarg;
+      }
+      break;
+
+      case OPT_ID_TIMING: {
+        if (strcasecmp(optarg, "rx") == 0) {
+          timing = TIMING_RX;
+        } else if (strcasecmp(optarg, "gps") == 0) {
+          timing = TIMING_GPS;
+        } else if (strcasecmp(optarg, "none") == 0) {
+          timing = TIMING_NONE;
+        } else {
+          printf("invalid timing\n");
+          return -1;
+        }
+      }
+      break;
+
+      case OPT_ID_RATE: {
+        rate = strtod(optarg, NULL);
+      }
+      break;
+
+      case OPT_ID_SEEK: {
+        char *end;
+        if (strchr(optarg, ':') != NULL) {
+          unsigned long wn = strtoul(optarg, &end, 10);
+          double tow_s = strtod(end + 1, &end);
+          seek = SEEK_GPS;
+          seek_ms = wn * GPS_WEEK_ms + (uint64_t)(tow_s * 1000.0);
+        } else {
+          double offset_s = strtod(optarg, &end);
+          seek = SEEK_OFFSET;
+          seek_ms = (uint64_t)(offset_s * 1000.0);
+        }
+        if (*end != '\0') {
+          printf("invalid seek time\n");
+          return -1;
+        }
+      }
+      break;
+
+      case OPT_ID_LOOP: {
+        loop = true;
+      }
+      break;
+
+      case OPT_ID_DEBUG: {
+        debug = true;
+      }
+      break;
+
+      default: {
+        printf("invalid option\n");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  if (zmq_pub_addr == NULL) {
+    printf("ZMQ address not specified\n");
+    return -1;
+  }
+
+  if (rate <= 0.0) {
+    printf("invalid rate\n");
+    return -1;
+  }
+
+  if (optind >= argc) {
+    printf("log file not specified\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+static bool block_before_seek(const log_block_header_t *header)
+{
+  if (seek == SEEK_GPS) {
+    return (header->gps_time_end_ms != 0) &&
+           (header->gps_time_end_ms < seek_ms);
+  }
+
+  return header->rx_time_end_ms < seek_rx_time_ms;
+}
+
+static bool record_before_seek(const log_record_t *record,
+                               uint64_t gps_time_ms)
+{
+  if (seek == SEEK_GPS) {
+    return (gps_time_ms == 0) || (gps_time_ms < seek_ms);
+  }
+
+  return record->rx_time_ms < seek_rx_time_ms;
+}
+
+static void pace(uint64_t log_time_ms)
+{
+  if ((timing == TIMING_NONE) || (log_time_ms == 0)) {
+    return;
+  }
+
+  int64_t now_ms = zclock_mono();
+
+  if (!pacing_valid || (log_time_ms < pacing_last_log_ms) ||
+      (log_time_ms - pacing_last_log_ms > TIMING_GAP_MAX_ms)) {
+    pacing_base_wall_ms = now_ms;
+    pacing_base_log_ms = log_time_ms;
+    pacing_last_log_ms = log_time_ms;
+    pacing_valid = true;
+    return;
+  }
+
+  pacing_last_log_ms = log_time_ms;
+
+  int64_t target_ms = pacing_base_wall_ms +
+      (int64_t)((log_time_ms - pacing_base_log_ms) / rate);
+  if (target_ms > now_ms) {
+    zclock_sleep(target_ms - now_ms);
+  }
+}
+
+static int record_send(zsock_t *pub, const log_record_t *record)
+{
+  zmsg_t *msg = zmsg_new();
+  if ((msg == NULL) ||
+      (zmsg_addmem(msg, record->data, record->length) != 0)) {
+    printf("error creating message\n");
+    zmsg_destroy(&msg);
+    return -1;
+  }
+
+  if (zmsg_send(&msg, pub) != 0) {
+    printf("zmsg_send() error\n");
+    zmsg_destroy(&msg);
+    return -1;
+  }
+
+  records_sent++;
+  return 0;
+}
+
+static int replay_file(zsock_t *pub, const char *path, uint8_t *buffer)
+{
+  log_reader_t *reader = log_reader_open(path);
+  if (reader == NULL) {
+    return -1;
+  }
+  debug_printf("replaying %s: %u blocks%s\n", path,
+               log_reader_block_count(reader),
+               log_reader_index_recovered(reader) ? " (index recovered)" : "");
+
+  int ret = 0;
+  for (uint32_t i=0; i<log_reader_block_count(reader); i++) {
+    const log_index_entry_t *block = log_reader_block(reader, i);
+
+    if (seeking && (seek == SEEK_OFFSET) && (seek_rx_time_ms == 0)) {
+      seek_rx_time_ms = block->header.rx_time_start_ms + seek_ms;
+    }
+
+    if (seeking && block_before_seek(&block->header)) {
+      continue;
+    }
+
+    int length = log_reader_block_read(reader, i, buffer);
+    if (length < 0) {
+      printf("%s: block %u is corrupt, skipping\n", path, i);
+      continue;
+    }
+
+    uint64_t gps_time_ms = block->header.gps_time_start_ms;
+    size_t offset = 0;
+    log_record_t record;
+    while (log_reader_record_next(block, buffer, length, &offset, &record)) {
+      if (zsys_interrupted) {
+        ret = -1;
+        goto done;
+      }
+
+      sbp_frame_gps_time(record.data, record.length, &gps_time_ms);
+
+      if (seeking) {
+        if (record_before_seek(&record, gps_time_ms)) {
+          continue;
+        }
+        seeking = false;
+        debug_printf("seek complete\n");
+      }
+
+      pace((timing == TIMING_GPS) ? gps_time_ms : record.rx_time_ms);
+
+      if (record_send(pub, &record) != 0) {
+        ret = -1;
+        goto done;
+      }
+    }
+  }
+
+done:
+  log_reader_close(&reader);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  zsock_t *pub = zsock_new(ZMQ_PUB);
+  if (pub == NULL) {
+    printf("zsock_new() error\n");
+    exit(1);
+  }
+
+  if (zsock_attach(pub, zmq_pub_addr, true) != 0) {
+    printf("zsock_attach() error\n");
+    zsock_destroy(&pub);
+    exit(1);
+  }
+  debug_printf("opened socket: %s\n", zmq_pub_addr);
+  zclock_sleep(CONNECT_DELAY_ms);
+
+  uint8_t *buffer = malloc(LOG_BLOCK_SIZE_MAX);
+  if (buffer == NULL) {
+    exit(1);
+  }
+
+  int ret = 0;
+  do {
+    seeking = (seek != SEEK_NONE);
+    seek_rx_time_ms = 0;
+    pacing_valid = false;
+
+    for (int i=optind; i<argc; i++) {
+      if (replay_file(pub, argv[i], buffer) != 0) {
+        ret = 1;
+        break;
+      }
+    }
+  } while (loop && (ret == 0) && !zsys_interrupted);
+
+  debug_printf("%llu messages sent\n", (unsigned long long)records_sent);
+
+  free(buffer);
+  zsock_destroy(&pub);
+  return ret;
+}
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <czmq.h>
+
+#include "log_writer.h"
+
+#define ROTATE_SIZE_DEFAULT_MB 64
+/* Largest file on a FAT32 card, the writer rotates early enough to keep
+ * the last block and the index within it */
+#define ROTATE_SIZE_MAX_MB 4095
+#define ROTATE_TIME_DEFAULT_s 3600
+#define BUFFER_COUNT_DEFAULT 16
+#define FLUSH_INTERVAL_DEFAULT_ms 1000
+
+static bool debug = false;
+static const char *zmq_sub_addr = NULL;
+static const char *log_dir = NULL;
+static log_format_t log_format = LOG_FORMAT_BLOCK;
+static uint32_t rotate_size_mb = ROTATE_SIZE_DEFAULT_MB;
+static uint32_t rotate_time_s = ROTATE_TIME_DEFAULT_s;
+static uint32_t buffer_count = BUFFER_COUNT_DEFAULT;
+static uint32_t flush_interval_ms = FLUSH_INTERVAL_DEFAULT_ms;
+static bool direct_io = false;
+
+static void debug_printf(const char *msg, ...)
+{
+  if (!debug) {
+    return;
+  }
+
+  va_list ap;
+  va_start(ap, msg);
+  vprintf(msg, ap);
+  va_end(ap);
+}
+
+static void usage(char *command)
+{
+  printf("Usage: %s\n", command);
+
+  puts("\nZMQ Mode");
+  puts("\t-s, --sub <addr>");
+  puts("\t\tsource socket");
+
+  puts("\nLog options");
+  puts("\t-d, --dir <dir>");
+  puts("\t\tdirectory in which to create log files");
+  puts("\t--format <raw|block>");
+  puts("\t\tblock (default) writes LZ4 compressed blocks with a time and");
+  puts("\t\tmessage type index, raw writes the SBP stream unmodified");
+  puts("\t--rotate-size <MB>");
+  puts("\t\tstart a new file after this many megabytes, 0 to disable");
+  puts("\t--rotate-time <s>");
+  puts("\t\tstart a new file after this many seconds, 0 to disable");
+  puts("\t--buffers <count>");
+  puts("\t\tnumber of 64 kB write buffers, data is dropped when all are full");
+  puts("\t--flush-interval <ms>");
+  puts("\t\tmaximum time data is held before being passed to the writer");
+  puts("\t--direct");
+  puts("\t\twrite with O_DIRECT, bypassing the page cache");
+
+  puts("\nMisc options");
+  puts("\t--debug");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_FORMAT = 1,
+    OPT_ID_ROTATE_SIZE,
+    OPT_ID_ROTATE_TIME,
+    OPT_ID_BUFFERS,
+    OPT_ID_FLUSH_INTERVAL,
+    OPT_ID_DIRECT,
+    OPT_ID_DEBUG
+  };
+
+  const struct option long_opts[] = {
+    {"sub",            required_argument, 0, 's'},
+    {"dir",            required_argument, 0, 'd'},
+    {"format",         required_argument, 0, OPT_ID_FORMAT},
+    {"rotate-size",    required_argument, 0, OPT_ID_ROTATE_SIZE},
+    {"rotate-time",    required_argument, 0, OPT_ID_ROTATE_TIME},
+    {"buffers",        required_argument, 0, OPT_ID_BUFFERS},
+    {"flush-interval", required_argument, 0, OPT_ID_FLUSH_INTERVAL},
+    {"direct",         no_argument,       0, OPT_ID_DIRECT},
+    {"debug",          no_argument,       0, OPT_ID_DEBUG},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "s:d:",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case 's': {
+        zmq_sub_addr = optarg;
+      }
+      break;
+
+      case 'd': {
+        log_dir = optarg;
+      }
+      break;
+
+      case OPT_ID_FORMAT: {
+        if (strcasecmp(optarg, "raw") == 0) {
+          log_format = LOG_FORMAT_RAW;
+        } else if (strcasecmp(optarg, "block") == 0) {
+          log_format = LOG_FORMAT_BLOCK;
+        } else {
+          printf("invalid format\n");
+          return -1;
+        }
+      }
+      break;
+
+      case OPT_ID_ROTATE_SIZE: {
+        char *end;
+        unsigned long size_mb = strtoul(optarg, &end, 10);
+        if ((end == optarg) || (*end != '\0') ||
+            (size_mb > ROTATE_SIZE_MAX_MB)) {
+          printf("invalid rotate size, at most %u MB\n", ROTATE_SIZE_MAX_MB);
+          return -1;
+        }
+        rotate_size_mb = size_mb;
+      }
+      break;
+
+      case OPT_ID_ROTATE_TIME: {
+        rotate_time_s = strtoul(optarg, NULL, 10);
+      }
+      break;
+
+      case OPT_ID_BUFFERS: {
+        buffer_count = strtoul(optarg, NULL, 10);
+      }
+      break;
+
+      case OPT_ID_FLUSH_INTERVAL: {
+        flush_interval_ms = strtoul(optarg, NULL, 10);
+      }
+      break;
+
+      case OPT_ID_DIRECT: {
+        direct_io = true;
+      }
+      break;
+
+      case OPT_ID_DEBUG: {
+        debug = true;
+      }
+      break;
+
+      default: {
+        printf("invalid option\n");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  if (zmq_sub_addr == NULL) {
+    printf("ZMQ address not specified\n");
+    return -1;
+  }
+
+  if (log_dir == NULL) {
+    printf("log directory not specified\n");
+    return -1;
+  }
+
+  if (buffer_count < 2) {
+    printf("at least two buffers are required\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
+{
+  log_writer_t *writer = (log_writer_t *)arg;
+
+  zmsg_t *msg = zmsg_recv(reader);
+  if (msg == NULL) {
+    printf("zmsg_recv() error\n");
+    return 0;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint64_t rx_time_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+  zframe_t *frame = zmsg_first(msg);
+  while (frame != NULL) {
+    log_writer_write(writer, rx_time_ms,
+                     zframe_data(frame), zframe_size(frame));
+    frame = zmsg_next(msg);
+  }
+
+  zmsg_destroy(&msg);
+  return 0;
+}
+
+static int flush_timer_fn(zloop_t *loop, int timer_id, void *arg)
+{
+  log_writer_t *writer = (log_writer_t *)arg;
+  static uint64_t dropped_bytes_reported = 0;
+
+  log_writer_flush(writer);
+
+  uint64_t dropped_bytes = log_writer_dropped_bytes(writer);
+  if (dropped_bytes != dropped_bytes_reported) {
+    printf("warning: %llu bytes dropped\n",
+           (unsigned long long)(dropped_bytes - dropped_bytes_reported));
+    dropped_bytes_reported = dropped_bytes;
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  log_writer_config_t config = {
+    .dir = log_dir,
+    .format = log_format,
+    .rotate_size = (uint64_t)rotate_size_mb * 1024 * 1024,
+    .rotate_time_s = rotate_time_s,
+    .buffer_count = buffer_count,
+    .direct_io = direct_io
+  };
+
+  log_writer_t *writer = log_writer_create(&config);
+  if (writer == NULL) {
+    printf("error creating log writer\n");
+    exit(1);
+  }
+
+  zsock_t *sub = zsock_new_sub(zmq_sub_addr, "");
+  if (sub == NULL) {
+    printf("zsock_new_sub() error\n");
+    exit(1);
+  }
+  debug_printf("opened socket: %s\n", zmq_sub_addr);
+
+  zloop_t *loop = zloop_new();
+  assert(loop);
+  zloop_reader(loop, sub, reader_fn, writer);
+  zloop_timer(loop, flush_interval_ms, 0, flush_timer_fn, writer);
+
+  zloop_start(loop);
+
+  zloop_destroy(&loop);
+  zsock_destroy(&sub);
+
+  /* Flush remaining data and close the current file */
+  log_writer_destroy(&writer);
+
+  return 0;
+}
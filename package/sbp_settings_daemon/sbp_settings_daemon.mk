@@ -7,7 +7,7 @@
 SBP_SETTINGS_DAEMON_VERSION = 0.1
 SBP_SETTINGS_DAEMON_SITE = "${BR2_EXTERNAL}/package/sbp_settings_daemon/src"
 SBP_SETTINGS_DAEMON_SITE_METHOD = local
-SBP_SETTINGS_DAEMON_DEPENDENCIES = czmq libsbp
+SBP_SETTINGS_DAEMON_DEPENDENCIES = czmq libsbp zlib daemon_util
 
 define SBP_SETTINGS_DAEMON_BUILD_CMDS
     $(MAKE) CC=$(TARGET_CC) LD=$(TARGET_LD) -C $(@D) all
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bulk.h"
+
+#define log_error(...) fprintf(stderr, __VA_ARGS__)
+
+#define BULK_TOKENS_MAX 8
+#define BULK_TOKEN_SIZE 16
+#define BULK_TOKEN_LIFETIME_s 30
+#define BULK_REQUEST_TIMEOUT_s 10
+#define BULK_REQUEST_SIZE_MAX 128
+#define BULK_SENDFILE_CHUNK (1024 * 1024)
+#define BULK_CHILDREN_MAX 4
+
+typedef struct {
+  char token[2 * BULK_TOKEN_SIZE + 1];
+  char path[PATH_MAX];
+  time_t expiry;
+} bulk_token_t;
+
+static int bulk_port;
+static int listen_fd = -1;
+static bulk_token_t tokens[BULK_TOKENS_MAX];
+static int children_count;
+
+static time_t now_s(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec;
+}
+
+static int token_generate(char *token)
+{
+  unsigned char bytes[BULK_TOKEN_SIZE];
+  int fd = open("/dev/urandom", O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  ssize_t n = read(fd, bytes, sizeof(bytes));
+  close(fd);
+  if (n != sizeof(bytes)) {
+    return -1;
+  }
+
+  for (int i = 0; i < BULK_TOKEN_SIZE; i++) {
+    sprintf(&token[2 * i], "%02x", bytes[i]);
+  }
+  return 0;
+}
+
+static const bulk_token_t *token_lookup(const char *token)
+{
+  time_t now = now_s();
+  for (int i = 0; i < BULK_TOKENS_MAX; i++) {
+    if ((tokens[i].expiry > now) && (strcmp(tokens[i].token, token) == 0)) {
+      return &tokens[i];
+    }
+  }
+  return NULL;
+}
+
+int bulk_open(const char *path, char *buf, size_t len)
+{
+  if (listen_fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if ((strlen(path) >= PATH_MAX) || (stat(path, &st) != 0) ||
+      !S_ISREG(st.st_mode)) {
+    return -1;
+  }
+
+  /* Reuse the slot that expires first */
+  bulk_token_t *t = &tokens[0];
+  for (int i = 1; i < BULK_TOKENS_MAX; i++) {
+    if (tokens[i].expiry < t->expiry) {
+      t = &tokens[i];
+    }
+  }
+
+  if (token_generate(t->token) != 0) {
+    t->expiry = 0;
+    return -1;
+  }
+  strcpy(t->path, path);
+  t->expiry = now_s() + BULK_TOKEN_LIFETIME_s;
+
+  return snprintf(buf, len, "%d %s %lld", bulk_port, t->token,
+                  (long long)st.st_size);
+}
+
+static int write_all(int fd, const char *buf, size_t len)
+{
+  while (len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+  return 0;
+}
+
+/* Handle one connection, runs in a child process */
+static int bulk_serve(int fd)
+{
+  struct timeval timeout = { .tv_sec = BULK_REQUEST_TIMEOUT_s };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char request[BULK_REQUEST_SIZE_MAX];
+  size_t request_len = 0;
+  while ((request_len == 0) || (request[request_len - 1] != '\n')) {
+    if (request_len == sizeof(request) - 1) {
+      return -1;
+    }
+    ssize_t n = read(fd, &request[request_len],
+                     sizeof(request) - 1 - request_len);
+    if (n <= 0) {
+      return -1;
+    }
+    request_len += n;
+  }
+  request[request_len] = '\0';
+
+  char token[2 * BULK_TOKEN_SIZE + 1];
+  unsigned long long offset;
+  unsigned long long length;
+  if (sscanf(request, "%32s %llu %llu", token, &offset, &length) != 3) {
+    write_all(fd, "ERR\n", 4);
+    return -1;
+  }
+
+  const bulk_token_t *t = token_lookup(token);
+  int file = (t != NULL) ? open(t->path, O_RDONLY) : -1;
+  struct stat st;
+  if ((file < 0) || (fstat(file, &st) != 0) ||
+      (offset > (unsigned long long)st.st_size)) {
+    write_all(fd, "ERR\n", 4);
+    return -1;
+  }
+
+  unsigned long long available = st.st_size - offset;
+  if ((length == 0) || (length > available)) {
+    length = available;
+  }
+
+  char header[32];
+  int header_len = snprintf(header, sizeof(header), "OK %llu\n", length);
+  if (write_all(fd, header, header_len) != 0) {
+    return -1;
+  }
+
+  posix_fadvise(file, offset, length, POSIX_FADV_SEQUENTIAL);
+  off_t pos = offset;
+  while (length > 0) {
+    size_t chunk = (length < BULK_SENDFILE_CHUNK) ? length :
+                                                    BULK_SENDFILE_CHUNK;
+    ssize_t n = sendfile(fd, file, &pos, chunk);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (n == 0) {
+      /* File was truncated */
+      return -1;
+    }
+    length -= n;
+  }
+
+  close(file);
+  return 0;
+}
+
+static int accept_fn(zloop_t *loop, zmq_pollitem_t *item, void *arg)
+{
+  (void)loop; (void)arg;
+
+  int fd = accept(item->fd, NULL, NULL);
+  if (fd < 0) {
+    return 0;
+  }
+
+  /* Reap finished children. This is done here rather than from a SIGCHLD
+   * handler, which would interrupt the zloop poll. */
+  while (waitpid(-1, NULL, WNOHANG) > 0) {
+    children_count--;
+  }
+
+  /* Each connection holds a process until it is served or times out, so
+   * bound them to keep other hosts from exhausting the process table */
+  if (children_count >= BULK_CHILDREN_MAX) {
+    write_all(fd, "ERR\n", 4);
+    close(fd);
+    return 0;
+  }
+
+  /* Serve each connection from its own process so that a slow client
+   * never stalls SBP handling. The child only touches the socket and the
+   * file, never ZMQ. */
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(listen_fd);
+    int ret = bulk_serve(fd);
+    shutdown(fd, SHUT_WR);
+    close(fd);
+    _exit(ret == 0 ? 0 : 1);
+  }
+
+  if (pid < 0) {
+    log_error("bulk: fork() error: %s\n", strerror(errno));
+  } else {
+    children_count++;
+  }
+  close(fd);
+  return 0;
+}
+
+int bulk_setup(zloop_t *loop, const char *addr, int port)
+{
+  struct sockaddr_in sin = {
+    .sin_family = AF_INET,
+    .sin_port = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_ANY)
+  };
+  if ((addr != NULL) && (inet_pton(AF_INET, addr, &sin.sin_addr) != 1)) {
+    log_error("bulk: invalid address %s\n", addr);
+    return -1;
+  }
+
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    log_error("bulk: socket() error: %s\n", strerror(errno));
+    return -1;
+  }
+
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  if ((bind(fd, (struct sockaddr *)&sin, sizeof(sin)) != 0) ||
+      (listen(fd, 4) != 0)) {
+    log_error("bulk: error listening on port %d: %s\n", port,
+              strerror(errno));
+    close(fd);
+    return -1;
+  }
+
+  zmq_pollitem_t item = { .socket = NULL, .fd = fd, .events = ZMQ_POLLIN };
+  if (zloop_poller(loop, &item, accept_fn, NULL) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  listen_fd = fd;
+  bulk_port = port;
+  return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_BULK_H
+#define SWIFTNAV_BULK_H
+
+#include <stddef.h>
+
+#include <czmq.h>
+
+/* Bulk file transfer over TCP, for clients that need more than SBP fileio
+ * can carry. A client first reads /bulk/open/<path> through fileio, which
+ * returns "<port> <token> <size>". It then connects to the port and sends
+ *   "<token> <offset> <length>\n"
+ * with a length of 0 meaning to the end of the file. The reply is
+ * "OK <length>\n" followed by the data, or "ERR\n". A token is valid for
+ * any number of connections until it expires. */
+
+/* Listen on addr, or on all interfaces if NULL. At most a few connections
+ * are served at a time, others are refused with "ERR\n". */
+int bulk_setup(zloop_t *loop, const char *addr, int port);
+
+/* Authorize transfers of a file. Writes the fileio reply to buf and
+ * returns its length, or -1 if the service is disabled or on error. */
+int bulk_open(const char *path, char *buf, size_t len);
+
+#endif  /* SWIFTNAV_BULK_H */
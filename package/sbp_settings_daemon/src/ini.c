@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ini.h"
+
+typedef struct {
+  const char *section;
+  const char *key;
+  const char *value;
+} ini_entry_t;
+
+struct ini_s {
+  /* Copy of the text, modified in place to terminate the strings */
+  char *text;
+  ini_entry_t *entries;
+  size_t count;
+  /* Entries sorted by section and key */
+  const ini_entry_t **index;
+};
+
+static char *trim(char *str)
+{
+  while (isspace((unsigned char)*str))
+    str++;
+  char *end = str + strlen(str);
+  while ((end > str) && isspace((unsigned char)end[-1]))
+    end--;
+  *end = '\0';
+  return str;
+}
+
+/* Remove a trailing comment and surrounding quotes from a value */
+static char *clean_value(char *value)
+{
+  bool quoted = false;
+  char *p;
+  for (p = value; *p != '\0'; p++) {
+    if (*p == '"') {
+      quoted = !quoted;
+    } else if ((*p == '\\') && (p[1] == '"')) {
+      p++;
+    } else if (!quoted && ((*p == ';') || (*p == '#'))) {
+      break;
+    }
+  }
+  *p = '\0';
+  value = trim(value);
+
+  size_t len = strlen(value);
+  if ((len >= 2) && (value[0] == '"') && (value[len - 1] == '"')) {
+    value[len - 1] = '\0';
+    value++;
+  }
+  return value;
+}
+
+static int entry_compare(const ini_entry_t *a, const char *section,
+                         const char *key)
+{
+  int ret = strcasecmp(a->section, section);
+  return (ret != 0) ? ret : strcasecmp(a->key, key);
+}
+
+static int index_compare(const void *a, const void *b)
+{
+  const ini_entry_t *ea = *(const ini_entry_t * const *)a;
+  const ini_entry_t *eb = *(const ini_entry_t * const *)b;
+  int ret = entry_compare(ea, eb->section, eb->key);
+  /* Keep the first of any duplicates first */
+  return (ret != 0) ? ret : (ea < eb) ? -1 : (ea > eb);
+}
+
+ini_t *ini_parse(const char *buf, size_t len)
+{
+  ini_t *ini = calloc(1, sizeof(*ini));
+  if (ini == NULL) {
+    return NULL;
+  }
+
+  ini->text = malloc(len + 1);
+  if (ini->text == NULL) {
+    ini_destroy(&ini);
+    return NULL;
+  }
+  memcpy(ini->text, buf, len);
+  ini->text[len] = '\0';
+
+  /* Every entry needs its own line */
+  size_t capacity = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (buf[i] == '\n') {
+      capacity++;
+    }
+  }
+
+  ini->entries = malloc(capacity * sizeof(*ini->entries));
+  if (ini->entries == NULL) {
+    ini_destroy(&ini);
+    return NULL;
+  }
+
+  const char *section = "";
+  char *line = ini->text;
+  while (line != NULL) {
+    char *next = strchr(line, '\n');
+    if (next != NULL) {
+      *next++ = '\0';
+    }
+
+    line = trim(line);
+    if (line[0] == '[') {
+      char *end = strchr(line, ']');
+      if (end != NULL) {
+        *end = '\0';
+        section = trim(line + 1);
+      }
+    } else if ((line[0] != '\0') && (line[0] != ';') && (line[0] != '#')) {
+      char *sep = strpbrk(line, "=:");
+      if (sep != NULL) {
+        *sep = '\0';
+        ini->entries[ini->count++] = (ini_entry_t) {
+          .section = section,
+          .key = trim(line),
+          .value = clean_value(sep + 1)
+        };
+      }
+    }
+
+    line = next;
+  }
+
+  ini->index = malloc(capacity * sizeof(*ini->index));
+  if (ini->index == NULL) {
+    ini_destroy(&ini);
+    return NULL;
+  }
+  for (size_t i = 0; i < ini->count; i++) {
+    ini->index[i] = &ini->entries[i];
+  }
+  qsort(ini->index, ini->count, sizeof(*ini->index), index_compare);
+
+  return ini;
+}
+
+ini_t *ini_load(const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ini_parse("", 0);
+  }
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+    close(fd);
+    return ini_parse("", 0);
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  ini_t *ini = ini_parse(map, st.st_size);
+  munmap(map, st.st_size);
+  return ini;
+}
+
+void ini_destroy(ini_t **ini)
+{
+  if (*ini == NULL) {
+    return;
+  }
+
+  free((*ini)->index);
+  free((*ini)->entries);
+  free((*ini)->text);
+  free(*ini);
+  *ini = NULL;
+}
+
+const char *ini_get(const ini_t *ini, const char *section, const char *key)
+{
+  size_t lo = 0;
+  size_t hi = ini->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (entry_compare(ini->index[mid], section, key) < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  if ((lo < ini->count) && (entry_compare(ini->index[lo], section, key) == 0)) {
+    return ini->index[lo]->value;
+  }
+  return NULL;
+}
+
+size_t ini_count(const ini_t *ini)
+{
+  return ini->count;
+}
+
+void ini_entry(const ini_t *ini, size_t index, const char **section,
+               const char **key, const char **value)
+{
+  const ini_entry_t *e = &ini->entries[index];
+  *section = e->section;
+  *key = e->key;
+  *value = e->value;
+}
+
+int ini_file_write(const char *path, const char *buf, size_t len)
+{
+  char tmp[256];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+
+  bool ok = (write(fd, buf, len) == (ssize_t)len) && (fsync(fd) == 0);
+  close(fd);
+
+  if (!ok || (rename(tmp, path) != 0)) {
+    unlink(tmp);
+    return -1;
+  }
+  return 0;
+}
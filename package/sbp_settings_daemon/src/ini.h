@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_INI_H
+#define SWIFTNAV_INI_H
+
+#include <stddef.h>
+
+/* In-memory INI file. The text is parsed once into a list of entries in
+ * file order plus an index sorted by section and key for lookups.
+ * Section and key names are case insensitive. Trailing comments and
+ * surrounding double quotes are removed from values. */
+typedef struct ini_s ini_t;
+
+/* Parse INI text. Returns NULL on allocation failure. */
+ini_t *ini_parse(const char *buf, size_t len);
+/* Parse a file. A missing file gives an empty ini_t. */
+ini_t *ini_load(const char *path);
+void ini_destroy(ini_t **ini);
+
+/* Returns the value, or NULL if not present. Valid until ini_destroy(). */
+const char *ini_get(const ini_t *ini, const char *section, const char *key);
+
+/* Entries in file order */
+size_t ini_count(const ini_t *ini);
+void ini_entry(const ini_t *ini, size_t index, const char **section,
+               const char **key, const char **value);
+
+/* Replace a file with buf: written to a temporary file, synced and
+ * renamed over the original */
+int ini_file_write(const char *path, const char *buf, size_t len);
+
+#endif  /* SWIFTNAV_INI_H */
@@ -12,17 +12,112 @@
 
 #include <libsbp/sbp.h>
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <daemon_util.h>
+
 #include "sbp_zmq.h"
 #include "settings.h"
 #include "sbp_fileio.h"
+#include "bulk.h"
+
+static int bulk_port = 0;
+static const char *bulk_addr = NULL;
+static const char *store_spec = NULL;
+
+static void usage(char *command)
+{
+  printf("Usage: %s\n", command);
+
+  daemon_usage();
+
+  puts("\nFile IO options");
+  puts("\t--bulk-port <port>");
+  puts("\t\tserve bulk file transfers authorized through fileio on this");
+  puts("\t\tTCP port, disabled by default");
+  puts("\t--bulk-addr <addr>");
+  puts("\t\tIPv4 address to serve bulk transfers on, all by default");
+
+  puts("\nSettings options");
+  puts("\t--store <mtd:<name>|file:<path>>");
+  puts("\t\tsave settings to an append-only log instead of rewriting");
+  puts("\t\tconfig.ini, which is migrated when the log is empty");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_BULK_PORT = 1,
+    OPT_ID_BULK_ADDR,
+    OPT_ID_STORE
+  };
 
-int main(void)
+  const struct option long_opts[] = {
+    DAEMON_LONG_OPTS,
+    {"bulk-port",   required_argument, 0, OPT_ID_BULK_PORT},
+    {"bulk-addr",   required_argument, 0, OPT_ID_BULK_ADDR},
+    {"store",       required_argument, 0, OPT_ID_STORE},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case OPT_ID_BULK_PORT: {
+        bulk_port = strtol(optarg, NULL, 10);
+      }
+      break;
+
+      case OPT_ID_BULK_ADDR: {
+        bulk_addr = optarg;
+      }
+      break;
+
+      case OPT_ID_STORE: {
+        store_spec = optarg;
+      }
+      break;
+
+      default: {
+        if (daemon_option(c, optarg) != 0) {
+          return -1;
+        }
+      }
+      break;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
 {
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  if ((daemon_sched_setup() != 0) || (daemon_memory_lock() != 0)) {
+    exit(1);
+  }
+
   sbp_state_t *sbp = sbp_zmq_init();
 
-  settings_setup(sbp);
+  settings_setup(sbp, store_spec);
   sbp_fileio_setup(sbp);
 
+  if (bulk_port > 0) {
+    if (bulk_setup(sbp_zmq_get_loop(sbp), bulk_addr, bulk_port) != 0) {
+      exit(1);
+    }
+  }
+
+  daemon_ready_notify();
   sbp_zmq_loop(sbp);
 
   return 0;
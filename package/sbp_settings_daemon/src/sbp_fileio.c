@@ -11,18 +11,76 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <alloca.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include <libsbp/file_io.h>
 
 #include "sbp_zmq.h"
 #include "sbp_fileio.h"
+#include "settings.h"
+#include "bulk.h"
+#include "transfer.h"
+#include "sha256.h"
 
 #define log_error(...) fprintf(stderr, __VA_ARGS__)
 
+/* Virtual files for transferring the whole settings table at once.
+ * The export is rendered when read from offset 0 so that a transfer sees
+ * one consistent copy. The import is collected from writes starting at
+ * offset 0 and applied by a zero length write. */
+#define SETTINGS_EXPORT_PATH "/settings/export.ini"
+#define SETTINGS_IMPORT_PATH "/settings/import.ini"
+#define SETTINGS_IMPORT_SIZE_MAX (64 * 1024)
+
+/* Virtual file containing the digest of a file, or of part of one:
+ *   /checksum/<crc32|sha256>/<path>[@<offset>,<length>]
+ * The contents are the digest in lower case hex, so a file can be checked
+ * without transferring it. A length of 0 means to the end of the file.
+ * The digest is computed when read from offset 0. A range starting at or
+ * beyond the end of a non-empty file is an error. At most
+ * CHECKSUM_SIZE_MAX bytes are hashed per request, as the hashing blocks
+ * the daemon, so larger files must be checked in ranges. */
+#define CHECKSUM_PATH_PREFIX "/checksum/"
+#define CHECKSUM_READ_SIZE (64 * 1024)
+/* Hashing runs in the event loop, so keep it to tens of milliseconds */
+#define CHECKSUM_SIZE_MAX (1024 * 1024)
+
+/* Virtual file authorizing a bulk TCP transfer of <path>, see bulk.h:
+ *   /bulk/open/<path>
+ * A new token is issued by each read from offset 0. */
+#define BULK_OPEN_PATH_PREFIX "/bulk/open"
+
+/* Virtual file listing the ranges of an upload not yet written, as
+ * "<offset> <length>" lines, see transfer.h:
+ *   /transfer/missing/<path>[@<size>]
+ * The list is rendered when read from offset 0. An upload that is not
+ * tracked reads as "unknown" unless a size is given. */
+#define TRANSFER_MISSING_PATH_PREFIX "/transfer/missing"
+
+static char checksum_spec[PATH_MAX];
+static char checksum_digest[2 * SHA256_DIGEST_SIZE + 1];
+static int checksum_len = -1;
+
+static char *missing_buf;
+static size_t missing_len;
+
+static char bulk_spec[PATH_MAX];
+static char bulk_reply[128];
+static int bulk_reply_len;
+
+static char *export_buf;
+static size_t export_len;
+static char *import_buf;
+static size_t import_len;
+
 static void read_cb(u16 sender_id, u8 len, u8 msg[], void* context);
 static void read_dir_cb(u16 sender_id, u8 len, u8 msg[], void* context);
 static void remove_cb(u16 sender_id, u8 len, u8 msg[], void* context);
@@ -33,12 +91,253 @@ static void write_cb(u16 sender_id, u8 len, u8 msg[], void* context);
  */
 void sbp_fileio_setup(sbp_state_t *sbp)
 {
+  transfer_setup();
+
   sbp_zmq_register_callback(sbp, SBP_MSG_FILEIO_READ_REQ, read_cb);
   sbp_zmq_register_callback(sbp, SBP_MSG_FILEIO_READ_DIR_REQ, read_dir_cb);
   sbp_zmq_register_callback(sbp, SBP_MSG_FILEIO_REMOVE, remove_cb);
   sbp_zmq_register_callback(sbp, SBP_MSG_FILEIO_WRITE_REQ, write_cb);
 }
 
+static int settings_export_read(u32 offset, u8 *buf, int len)
+{
+  if ((offset == 0) || (export_buf == NULL)) {
+    free(export_buf);
+    export_buf = NULL;
+    export_len = 0;
+    if (settings_export(&export_buf, &export_len) != 0) {
+      log_error("Error exporting settings\n");
+      return 0;
+    }
+  }
+
+  if (offset >= export_len)
+    return 0;
+
+  len = MIN(len, export_len - offset);
+  memcpy(buf, &export_buf[offset], len);
+  return len;
+}
+
+static void settings_import_write(sbp_state_t *sbp, u32 offset,
+                                  const u8 *buf, int len)
+{
+  if (len == 0) {
+    if (import_buf != NULL) {
+      int count = settings_import(sbp, import_buf, import_len);
+      if (count < 0)
+        log_error("Error importing settings\n");
+    }
+    free(import_buf);
+    import_buf = NULL;
+    import_len = 0;
+    return;
+  }
+
+  if (offset == 0)
+    import_len = 0;
+
+  if ((offset > import_len) || (offset + len > SETTINGS_IMPORT_SIZE_MAX)) {
+    log_error("Invalid settings import write\n");
+    return;
+  }
+
+  if (import_buf == NULL) {
+    import_buf = malloc(SETTINGS_IMPORT_SIZE_MAX);
+    if (import_buf == NULL)
+      return;
+  }
+
+  memcpy(&import_buf[offset], buf, len);
+  import_len = MAX(import_len, offset + len);
+}
+
+/* Compute the digest for a checksum path, returns the length of the hex
+ * string written to out or -1 on error */
+static int checksum_compute(const char *spec, char *out, size_t out_len)
+{
+  const char *path_start = strchr(spec, '/');
+  if ((path_start == NULL) || (strlen(path_start) >= PATH_MAX))
+    return -1;
+
+  bool sha256;
+  size_t type_len = path_start - spec;
+  if ((type_len == 5) && (strncmp(spec, "crc32", type_len) == 0))
+    sha256 = false;
+  else if ((type_len == 6) && (strncmp(spec, "sha256", type_len) == 0))
+    sha256 = true;
+  else
+    return -1;
+
+  char path[PATH_MAX];
+  strcpy(path, path_start);
+
+  /* Optional range suffix */
+  unsigned long offset = 0;
+  unsigned long length = 0;
+  char *range = strrchr(path, '@');
+  if (range != NULL) {
+    char *end;
+    offset = strtoul(range + 1, &end, 10);
+    if ((end != range + 1) && (*end == ',')) {
+      char *length_str = end + 1;
+      length = strtoul(length_str, &end, 10);
+      if ((end != length_str) && (*end == '\0'))
+        *range = '\0';
+      else
+        offset = length = 0;
+    } else {
+      offset = 0;
+    }
+  }
+
+  int f = open(path, O_RDONLY);
+  if (f < 0)
+    return -1;
+
+  struct stat st;
+  if ((fstat(f, &st) != 0) ||
+      ((offset != 0) && ((off_t)offset >= st.st_size)) ||
+      (lseek(f, offset, SEEK_SET) < 0)) {
+    close(f);
+    return -1;
+  }
+
+  unsigned long size = (length != 0) ? length :
+      ((st.st_size > (off_t)offset) ? st.st_size - offset : 0);
+  if (size > CHECKSUM_SIZE_MAX) {
+    log_error("Checksum of %s too large, use ranges\n", path);
+    close(f);
+    return -1;
+  }
+  posix_fadvise(f, offset, length, POSIX_FADV_SEQUENTIAL);
+
+  u8 *buf = malloc(CHECKSUM_READ_SIZE);
+  if (buf == NULL) {
+    close(f);
+    return -1;
+  }
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  sha256_t sha;
+  sha256_init(&sha);
+
+  bool to_end = (length == 0);
+  ssize_t n = 0;
+  while (to_end || (length > 0)) {
+    size_t chunk = to_end ? CHECKSUM_READ_SIZE : MIN(length, CHECKSUM_READ_SIZE);
+    n = read(f, buf, chunk);
+    if (n <= 0)
+      break;
+    if (sha256)
+      sha256_update(&sha, buf, n);
+    else
+      crc = crc32(crc, buf, n);
+    if (!to_end)
+      length -= n;
+  }
+
+  free(buf);
+  close(f);
+
+  /* A range beyond the end of the file is an error */
+  if ((n < 0) || (!to_end && (length > 0)))
+    return -1;
+
+  if (!sha256)
+    return snprintf(out, out_len, "%08lx", (unsigned long)crc);
+
+  u8 digest[SHA256_DIGEST_SIZE];
+  sha256_final(&sha, digest);
+  int len = 0;
+  for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+    len += snprintf(out + len, out_len - len, "%02x", digest[i]);
+  return len;
+}
+
+static int checksum_read(const char *filename, u32 offset, u8 *buf, int len)
+{
+  const char *spec = filename + strlen(CHECKSUM_PATH_PREFIX);
+  if (strlen(spec) >= sizeof(checksum_spec))
+    return 0;
+
+  /* Later reads of the same file are served from the digest computed at
+   * offset 0 */
+  if ((offset == 0) || (strcmp(spec, checksum_spec) != 0)) {
+    strcpy(checksum_spec, spec);
+    checksum_len = checksum_compute(spec, checksum_digest,
+                                    sizeof(checksum_digest));
+  }
+
+  if ((checksum_len < 0) || (offset >= (u32)checksum_len))
+    return 0;
+
+  len = MIN(len, checksum_len - (int)offset);
+  memcpy(buf, &checksum_digest[offset], len);
+  return len;
+}
+
+static int bulk_open_read(const char *filename, u32 offset, u8 *buf, int len)
+{
+  const char *spec = filename + strlen(BULK_OPEN_PATH_PREFIX);
+  if (strlen(spec) >= sizeof(bulk_spec))
+    return 0;
+
+  /* Later reads of the same file are served from the reply issued at
+   * offset 0 */
+  if ((offset == 0) || (strcmp(spec, bulk_spec) != 0)) {
+    strcpy(bulk_spec, spec);
+    bulk_reply_len = bulk_open(spec, bulk_reply, sizeof(bulk_reply));
+  }
+
+  if ((bulk_reply_len < 0) || (offset >= (u32)bulk_reply_len))
+    return 0;
+
+  len = MIN(len, bulk_reply_len - (int)offset);
+  memcpy(buf, &bulk_reply[offset], len);
+  return len;
+}
+
+static int transfer_missing_read(const char *filename, u32 offset, u8 *buf,
+                                 int len)
+{
+  if ((offset == 0) || (missing_buf == NULL)) {
+    free(missing_buf);
+    missing_buf = NULL;
+    missing_len = 0;
+
+    char path[PATH_MAX];
+    const char *spec = filename + strlen(TRANSFER_MISSING_PATH_PREFIX);
+    if (strlen(spec) >= sizeof(path))
+      return 0;
+    strcpy(path, spec);
+
+    /* Optional size suffix */
+    u32 size = 0;
+    char *size_str = strrchr(path, '@');
+    if (size_str != NULL) {
+      char *end;
+      size = strtoul(size_str + 1, &end, 10);
+      if ((end != size_str + 1) && (*end == '\0'))
+        *size_str = '\0';
+      else
+        size = 0;
+    }
+
+    if (transfer_missing(path, size, &missing_buf, &missing_len) != 0) {
+      log_error("Error listing missing ranges\n");
+      return 0;
+    }
+  }
+
+  if (offset >= missing_len)
+    return 0;
+
+  len = MIN(len, missing_len - offset);
+  memcpy(buf, &missing_buf[offset], len);
+  return len;
+}
+
 /** File read callback.
  * Responds to a SBP_MSG_FILEIO_READ_REQ message.
  *
@@ -62,12 +361,26 @@ static void read_cb(u16 sender_id, u8 len, u8 msg_[], void* sbp)
   int readlen = MIN(msg->chunk_size, SBP_FRAMING_MAX_PAYLOAD_SIZE - sizeof(*reply));
   reply = alloca(sizeof(msg_fileio_read_resp_t) + readlen);
   reply->sequence = msg->sequence;
-  int f = open(msg->filename, O_RDONLY);
-  lseek(f, msg->offset, SEEK_SET);
-  readlen = read(f, &reply->contents, readlen);
-  if (readlen < 0)
-    readlen = 0;
-  close(f);
+  if (strcmp(msg->filename, SETTINGS_EXPORT_PATH) == 0) {
+    readlen = settings_export_read(msg->offset, reply->contents, readlen);
+  } else if (strncmp(msg->filename, CHECKSUM_PATH_PREFIX,
+                     strlen(CHECKSUM_PATH_PREFIX)) == 0) {
+    readlen = checksum_read(msg->filename, msg->offset, reply->contents, readlen);
+  } else if (strncmp(msg->filename, BULK_OPEN_PATH_PREFIX "/",
+                     strlen(BULK_OPEN_PATH_PREFIX "/")) == 0) {
+    readlen = bulk_open_read(msg->filename, msg->offset, reply->contents, readlen);
+  } else if (strncmp(msg->filename, TRANSFER_MISSING_PATH_PREFIX "/",
+                     strlen(TRANSFER_MISSING_PATH_PREFIX "/")) == 0) {
+    readlen = transfer_missing_read(msg->filename, msg->offset,
+                                    reply->contents, readlen);
+  } else {
+    int f = open(msg->filename, O_RDONLY);
+    lseek(f, msg->offset, SEEK_SET);
+    readlen = read(f, &reply->contents, readlen);
+    if (readlen < 0)
+      readlen = 0;
+    close(f);
+  }
 
   sbp_zmq_send_msg(sbp, SBP_MSG_FILEIO_READ_RESP,
                    sizeof(*reply) + readlen, (u8*)reply);
@@ -143,6 +456,7 @@ static void remove_cb(u16 sender_id, u8 len, u8 msg[], void* context)
   msg[len] = 0;
 
   unlink((char*)msg);
+  transfer_remove((char*)msg);
 }
 
 /* Write to file callback.
@@ -164,10 +478,25 @@ static void write_cb(u16 sender_id, u8 len, u8 msg_[], void* sbp)
   }
 
   u8 headerlen = sizeof(*msg) + strlen(msg->filename) + 1;
-  int f = open(msg->filename, O_WRONLY | O_CREAT, 0666);
-  lseek(f, msg->offset, SEEK_SET);
-  write(f, msg_ + headerlen, len - headerlen);
-  close(f);
+  if (strcmp(msg->filename, SETTINGS_IMPORT_PATH) == 0) {
+    settings_import_write(sbp, msg->offset, msg_ + headerlen, len - headerlen);
+  } else {
+    int f = open(msg->filename, O_WRONLY | O_CREAT, 0666);
+
+    /* Writes only ever extend the file, so a shorter file was truncated
+     * since the ranges were recorded */
+    struct stat st;
+    if ((f >= 0) && (fstat(f, &st) == 0) && (st.st_size < UINT32_MAX))
+      transfer_truncate(msg->filename, st.st_size);
+
+    lseek(f, msg->offset, SEEK_SET);
+    ssize_t written = write(f, msg_ + headerlen, len - headerlen);
+    close(f);
+
+    /* Only data that reached the file counts towards the upload */
+    if (written == len - headerlen)
+      transfer_write(msg->filename, msg->offset, written);
+  }
 
   msg_fileio_write_resp_t reply = {.sequence = msg->sequence};
   sbp_zmq_send_msg(sbp, SBP_MSG_FILEIO_WRITE_RESP, sizeof(reply), (u8*)&reply);
@@ -11,20 +11,38 @@
  */
 
 #include <libsbp/sbp.h>
+#include <libsbp/edc.h>
 #include <czmq.h>
 
 #include <stdlib.h>
 
 #include "sbp_zmq.h"
 
+#define SBP_HEADER_LEN 6
+#define SBP_CRC_LEN 2
+#define SBP_FRAME_LEN_MAX (SBP_HEADER_LEN + 255 + SBP_CRC_LEN)
+
+/* Callbacks are found by msg_type in two levels of 256 entries, with the
+ * second level allocated on first registration */
+#define CALLBACK_PAGE_COUNT 256
+#define CALLBACK_PAGE_SIZE 256
+
+typedef struct {
+  sbp_msg_callback_t cb;
+  void *context;
+} callback_entry_t;
+
 static u16 sender_id = SBP_SENDER_ID;
 
 static struct sbp_zmq_ctx {
   zsock_t *pub, *sub;
+  zloop_t *loop;
   u8 send_buf[255+8];
   u16 send_len;
-  u8 *recv_buf;
-  u16 recv_len;
+  /* Partial frame carried over between ZMQ frames */
+  u8 carry_buf[SBP_FRAME_LEN_MAX];
+  u16 carry_len;
+  callback_entry_t *callbacks[CALLBACK_PAGE_COUNT];
 } sbp_zmq_ctx;
 
 static u32 sbp_write(u8 *buf, u32 n, void *context)
@@ -51,14 +69,85 @@ void sbp_zmq_send_msg(sbp_state_t *sbp, u16 msg_type, u8 len, u8 buff[])
   sbp_write_flush(ctx);
 }
 
-static u32 sbp_read(u8 *buff, u32 n, void *context)
+static callback_entry_t *callback_lookup(struct sbp_zmq_ctx *ctx, u16 msg_type)
 {
-  struct sbp_zmq_ctx *ctx = context;
-  size_t len = MIN(n, ctx->recv_len);
-  memcpy(buff, ctx->recv_buf, len);
-  ctx->recv_buf += len;
-  ctx->recv_len -= len;
-  return len;
+  callback_entry_t *page = ctx->callbacks[msg_type >> 8];
+  if (page == NULL)
+    return NULL;
+
+  callback_entry_t *entry = &page[msg_type & 0xff];
+  return (entry->cb != NULL) ? entry : NULL;
+}
+
+/* Dispatch one frame starting at a preamble. Returns the number of bytes
+ * consumed, or 0 if the frame is incomplete. */
+static size_t frame_process(struct sbp_zmq_ctx *ctx, u8 *buf, size_t len)
+{
+  if (len < SBP_HEADER_LEN)
+    return 0;
+
+  u16 msg_type = buf[1] | (buf[2] << 8);
+  u16 sender = buf[3] | (buf[4] << 8);
+  u8 payload_len = buf[5];
+  size_t frame_len = SBP_HEADER_LEN + payload_len + SBP_CRC_LEN;
+  if (len < frame_len)
+    return 0;
+
+  /* Frames from the router have already been checked by the framer, so
+   * only messages which are handled pay for the CRC */
+  callback_entry_t *entry = callback_lookup(ctx, msg_type);
+  if (entry == NULL)
+    return frame_len;
+
+  u16 crc = buf[SBP_HEADER_LEN + payload_len] |
+            (buf[SBP_HEADER_LEN + payload_len + 1] << 8);
+  if (crc16_ccitt(&buf[1], SBP_HEADER_LEN - 1 + payload_len, 0) != crc) {
+    /* Resynchronize at the next preamble */
+    return 1;
+  }
+
+  entry->cb(sender, payload_len, &buf[SBP_HEADER_LEN], entry->context);
+  return frame_len;
+}
+
+static void carry_process(struct sbp_zmq_ctx *ctx, u8 **buf, size_t *len)
+{
+  while ((ctx->carry_len > 0) && (*len > 0)) {
+    size_t target = (ctx->carry_len < SBP_HEADER_LEN) ? SBP_HEADER_LEN :
+        SBP_HEADER_LEN + ctx->carry_buf[5] + SBP_CRC_LEN;
+    size_t n = MIN(target - ctx->carry_len, *len);
+    memcpy(&ctx->carry_buf[ctx->carry_len], *buf, n);
+    ctx->carry_len += n;
+    *buf += n;
+    *len -= n;
+
+    if ((ctx->carry_len == target) && (target > SBP_HEADER_LEN)) {
+      /* Complete frame. A corrupt one is simply dropped. */
+      frame_process(ctx, ctx->carry_buf, ctx->carry_len);
+      ctx->carry_len = 0;
+    }
+  }
+}
+
+static void buffer_process(struct sbp_zmq_ctx *ctx, u8 *buf, size_t len)
+{
+  carry_process(ctx, &buf, &len);
+
+  size_t i = 0;
+  while (i < len) {
+    u8 *preamble = memchr(&buf[i], SBP_PREAMBLE, len - i);
+    if (preamble == NULL)
+      break;
+    i = preamble - buf;
+
+    size_t n = frame_process(ctx, &buf[i], len - i);
+    if (n == 0) {
+      memcpy(ctx->carry_buf, &buf[i], len - i);
+      ctx->carry_len = len - i;
+      break;
+    }
+    i += n;
+  }
 }
 
 void sbp_zmq_process(sbp_state_t *sbp)
@@ -66,34 +155,65 @@ void sbp_zmq_process(sbp_state_t *sbp)
   struct sbp_zmq_ctx *ctx = sbp->io_context;
   zmsg_t *msg = zmsg_recv(ctx->sub);
   for (zframe_t *frame = zmsg_first(msg); frame; frame = zmsg_next(msg)) {
-    ctx->recv_buf = zframe_data(frame);
-    ctx->recv_len = zframe_size(frame);
-    while (ctx->recv_len)
-      sbp_process(sbp, sbp_read);
+    buffer_process(ctx, zframe_data(frame), zframe_size(frame));
   }
   zmsg_destroy(&msg);
 }
 
 s8 sbp_zmq_register_callback(sbp_state_t *s, u16 msg_type, sbp_msg_callback_t cb)
 {
-  sbp_msg_callbacks_node_t *node = malloc(sizeof(*node));
-  return sbp_register_callback(s, msg_type, cb, s, node);
+  struct sbp_zmq_ctx *ctx = s->io_context;
+
+  if (cb == NULL)
+    return SBP_NULL_ERROR;
+
+  callback_entry_t **page = &ctx->callbacks[msg_type >> 8];
+  if (*page == NULL) {
+    *page = calloc(CALLBACK_PAGE_SIZE, sizeof(callback_entry_t));
+    if (*page == NULL)
+      return SBP_CALLBACK_ERROR;
+  }
+
+  callback_entry_t *entry = &(*page)[msg_type & 0xff];
+  if (entry->cb != NULL)
+    return SBP_CALLBACK_ERROR;
+
+  /* Only receive message types which are handled. The subscription is
+   * passed on to the router, which then drops everything else before it
+   * is sent. zsock_set_subscribe() can not be used as the prefix may
+   * contain zero bytes. */
+  u8 prefix[3] = { SBP_PREAMBLE, msg_type & 0xff, (msg_type >> 8) & 0xff };
+  if (zmq_setsockopt(zsock_resolve(ctx->sub), ZMQ_SUBSCRIBE,
+                     prefix, sizeof(prefix)) != 0)
+    return SBP_CALLBACK_ERROR;
+
+  entry->cb = cb;
+  entry->context = s;
+  return SBP_OK;
 }
 
 sbp_state_t *sbp_zmq_init(void)
 {
   sbp_state_t *sbp = malloc(sizeof(*sbp));
-  struct sbp_zmq_ctx *ctx = malloc(sizeof(*ctx));
+  struct sbp_zmq_ctx *ctx = calloc(1, sizeof(*ctx));
 
   /* Setup ZMQ sockets and SBP state */
   sbp_state_init(sbp);
   ctx->pub =  zsock_new_pub(">tcp://localhost:43021");
-  ctx->sub = zsock_new_sub(">tcp://localhost:43020", "");
+  /* Subscriptions are added as callbacks are registered */
+  ctx->sub = zsock_new_sub(">tcp://localhost:43020", NULL);
+  ctx->loop = zloop_new();
   sbp_state_set_io_context(sbp, ctx);
 
   return sbp;
 }
 
+zloop_t *sbp_zmq_get_loop(sbp_state_t *sbp)
+{
+  struct sbp_zmq_ctx *ctx = sbp->io_context;
+  return ctx->loop;
+}
+
 static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
 {
   (void)loop; (void)reader;
@@ -106,18 +226,15 @@ void sbp_zmq_loop(sbp_state_t *sbp)
   struct sbp_zmq_ctx *ctx = sbp->io_context;
 
   /* Run message handler loop */
-  zloop_t *loop = zloop_new();
-  zloop_reader(loop, ctx->sub, reader_fn, sbp);
-  zloop_start(loop);
+  zloop_reader(ctx->loop, ctx->sub, reader_fn, sbp);
+  zloop_start(ctx->loop);
 
   /* Cleanup */
+  zloop_destroy(&ctx->loop);
   zsock_destroy(&ctx->pub);
   zsock_destroy(&ctx->sub);
-  while(sbp->sbp_msg_callbacks_head) {
-    sbp_msg_callbacks_node_t *n = sbp->sbp_msg_callbacks_head;
-    sbp->sbp_msg_callbacks_head = n->next;
-    free(n);
-  }
+  for (int i = 0; i < CALLBACK_PAGE_COUNT; i++)
+    free(ctx->callbacks[i]);
   free(ctx);
   free(sbp);
 }
@@ -22,6 +22,8 @@ sbp_state_t *sbp_zmq_init(void);
 void sbp_zmq_send_msg(sbp_state_t *s, u16 msg_type, u8 len, u8 buff[]);
 s8 sbp_zmq_register_callback(sbp_state_t *s, u16 msg_type, sbp_msg_callback_t cb);
 void sbp_zmq_loop(sbp_state_t *s);
+/* Loop used by sbp_zmq_loop(), for adding timers before it is started */
+zloop_t *sbp_zmq_get_loop(sbp_state_t *s);
 
 #endif
 
@@ -12,18 +12,59 @@
 
 #include <libsbp/sbp.h>
 #include <libsbp/settings.h>
+#include <libsbp/edc.h>
 
 #include <string.h>
 #include <stdio.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "sbp_zmq.h"
-
-#include "minIni/minIni.h"
+#include "settings.h"
+#include "ini.h"
+#include "settings_store.h"
 
 #define SETTINGS_FILE "/persistent/config.ini"
 #define BUFSIZE 256
 
+/* Change events for local consumers. Each event is a multipart message:
+ *   "<section>.<name>"  topic, for prefix subscriptions
+ *   "<section>"
+ *   "<name>"
+ *   "<value>"
+ *   "<version>"         decimal, incremented on every change
+ * Consumers should read the current value with SBP_MSG_SETTINGS_READ_REQ
+ * after subscribing, then apply events with a newer version. */
+#define SETTINGS_NOTIFY_ADDR "@tcp://127.0.0.1:43040"
+
+/* Registered settings are saved here so that they can be enumerated at
+ * boot before the firmware has registered them again. The file is a
+ * snapshot_header_t followed by count entries, each being the section,
+ * name, value and type as null terminated strings, in list order. It is
+ * only rewritten when its contents change. Entries not registered again
+ * by the time registrations settle are dropped. */
+#define SNAPSHOT_FILE "/persistent/settings.snapshot"
+#define SNAPSHOT_MAGIC 0x504e5353 /* "SSNP" */
+#define SNAPSHOT_VERSION 1
+/* Wait for registrations to settle before writing to flash */
+#define SNAPSHOT_DELAY_ms 2000
+
+typedef struct __attribute__((packed)) {
+  u32 magic;
+  u16 version;
+  u16 count;
+  u32 length;
+  u16 crc;
+  u16 reserved;
+} snapshot_header_t;
+
+/* Reads of a setting are forwarded to the firmware after a write until
+ * its read response arrives, or for at most this long */
+#define WRITE_PENDING_TIMEOUT_ms 1000
+
 #define log_error(...) fprintf(stderr, __VA_ARGS__)
 
 struct setting {
@@ -33,9 +74,246 @@ struct setting {
   char value[BUFSIZE];
   struct setting *next;
   bool dirty;
+  /* False until registered by the firmware, if loaded from the snapshot */
+  bool registered;
+  u32 version;
+  /* zclock_mono() time of a write not yet answered, 0 if none */
+  int64_t write_pending_ms;
 };
 
 static struct setting *settings_head;
+/* Contents of SETTINGS_FILE, consulted when settings are registered */
+static ini_t *settings_ini;
+/* Used instead of SETTINGS_FILE if configured */
+static settings_store_t *settings_store;
+static zsock_t *notify_pub;
+static u32 settings_version;
+static zloop_t *settings_loop;
+static int snapshot_timer = -1;
+
+/* Append a string to the snapshot buffer */
+static size_t snapshot_put(char *buf, size_t offset, const char *str)
+{
+  size_t len = strlen(str) + 1;
+  memcpy(&buf[offset], str, len);
+  return offset + len;
+}
+
+/* True if the snapshot file already holds exactly buf */
+static bool settings_snapshot_matches(const char *buf, size_t len)
+{
+  int fd = open(SNAPSHOT_FILE, O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  bool match = false;
+  if ((fstat(fd, &st) == 0) && ((size_t)st.st_size == len)) {
+    const char *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      match = (memcmp(map, buf, len) == 0);
+      munmap((void *)map, len);
+    }
+  }
+  close(fd);
+  return match;
+}
+
+static void settings_snapshot_write(void)
+{
+  u16 count = 0;
+  size_t length = 0;
+  for (struct setting *s = settings_head; s; s = s->next) {
+    /* Drop settings the firmware no longer registers */
+    if (!s->registered)
+      continue;
+    count++;
+    length += strlen(s->section) + strlen(s->name) +
+              strlen(s->value) + strlen(s->type) + 4;
+  }
+
+  char *buf = malloc(sizeof(snapshot_header_t) + length);
+  if (buf == NULL)
+    return;
+
+  size_t offset = sizeof(snapshot_header_t);
+  for (struct setting *s = settings_head; s; s = s->next) {
+    if (!s->registered)
+      continue;
+    offset = snapshot_put(buf, offset, s->section);
+    offset = snapshot_put(buf, offset, s->name);
+    offset = snapshot_put(buf, offset, s->value);
+    offset = snapshot_put(buf, offset, s->type);
+  }
+
+  snapshot_header_t header = {
+    .magic = SNAPSHOT_MAGIC,
+    .version = SNAPSHOT_VERSION,
+    .count = count,
+    .length = length,
+    .crc = crc16_ccitt((u8 *)&buf[sizeof(header)], length, 0),
+    .reserved = 0
+  };
+  memcpy(buf, &header, sizeof(header));
+
+  /* Avoid flash writes when nothing has changed, e.g. at every boot */
+  size_t total = sizeof(header) + length;
+  if (settings_snapshot_matches(buf, total)) {
+    free(buf);
+    return;
+  }
+
+  /* Replace the old snapshot atomically */
+  const char *tmp = SNAPSHOT_FILE ".tmp";
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    log_error("Error opening settings snapshot\n");
+    free(buf);
+    return;
+  }
+
+  bool ok = (write(fd, buf, total) == (ssize_t)total) && (fsync(fd) == 0);
+  close(fd);
+  free(buf);
+
+  if (!ok || (rename(tmp, SNAPSHOT_FILE) != 0)) {
+    log_error("Error writing settings snapshot\n");
+    unlink(tmp);
+  }
+}
+
+/* Add settings from the snapshot, in the saved order */
+static void settings_snapshot_load(void)
+{
+  int fd = open(SNAPSHOT_FILE, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) ||
+      (st.st_size < (off_t)sizeof(snapshot_header_t))) {
+    close(fd);
+    return;
+  }
+
+  const char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return;
+
+  snapshot_header_t header;
+  memcpy(&header, map, sizeof(header));
+  const char *data = &map[sizeof(header)];
+  if ((header.magic != SNAPSHOT_MAGIC) ||
+      (header.version != SNAPSHOT_VERSION) ||
+      (sizeof(header) + header.length != (size_t)st.st_size) ||
+      (header.length == 0) || (data[header.length - 1] != '\0') ||
+      (crc16_ccitt((const u8 *)data, header.length, 0) != header.crc)) {
+    log_error("Ignoring invalid settings snapshot\n");
+    munmap((void *)map, st.st_size);
+    return;
+  }
+
+  struct setting *tail = NULL;
+  size_t offset = 0;
+  for (u16 i = 0; i < header.count; i++) {
+    const char *fields[4];
+    for (int f = 0; f < 4; f++) {
+      if (offset >= header.length)
+        goto done;
+      fields[f] = &data[offset];
+      offset += strlen(fields[f]) + 1;
+    }
+
+    struct setting *s = calloc(1, sizeof(*s));
+    if (s == NULL)
+      break;
+    strncpy(s->section, fields[0], BUFSIZE - 1);
+    strncpy(s->name, fields[1], BUFSIZE - 1);
+    strncpy(s->value, fields[2], BUFSIZE - 1);
+    strncpy(s->type, fields[3], BUFSIZE - 1);
+
+    if (tail == NULL)
+      settings_head = s;
+    else
+      tail->next = s;
+    tail = s;
+  }
+
+done:
+  munmap((void *)map, st.st_size);
+}
+
+/* Once the firmware has registered settings, those it did not register
+ * again are stale and are removed */
+static void settings_snapshot_prune(void)
+{
+  bool registered = false;
+  for (struct setting *s = settings_head; s; s = s->next)
+    registered |= s->registered;
+  if (!registered)
+    return;
+
+  struct setting **p = &settings_head;
+  while (*p != NULL) {
+    struct setting *s = *p;
+    if (s->registered) {
+      p = &s->next;
+      continue;
+    }
+    *p = s->next;
+    free(s);
+  }
+}
+
+static int snapshot_timer_fn(zloop_t *loop, int timer_id, void *arg)
+{
+  (void)loop; (void)timer_id; (void)arg;
+  snapshot_timer = -1;
+  settings_snapshot_prune();
+  settings_snapshot_write();
+  return 0;
+}
+
+/* Write the snapshot once changes have stopped for SNAPSHOT_DELAY_ms */
+static void settings_snapshot_schedule(void)
+{
+  if (settings_loop == NULL)
+    return;
+
+  if (snapshot_timer >= 0)
+    zloop_timer_end(settings_loop, snapshot_timer);
+  snapshot_timer = zloop_timer(settings_loop, SNAPSHOT_DELAY_ms, 1,
+                               snapshot_timer_fn, NULL);
+}
+
+/* Publish a change event for a setting */
+static void settings_notify(struct setting *s)
+{
+  s->version = ++settings_version;
+  settings_snapshot_schedule();
+
+  if (notify_pub == NULL) {
+    return;
+  }
+
+  char topic[2 * BUFSIZE];
+  snprintf(topic, sizeof(topic), "%s.%s", s->section, s->name);
+  char version[16];
+  snprintf(version, sizeof(version), "%u", s->version);
+
+  zmsg_t *msg = zmsg_new();
+  if ((msg == NULL) ||
+      (zmsg_addstr(msg, topic) != 0) ||
+      (zmsg_addstr(msg, s->section) != 0) ||
+      (zmsg_addstr(msg, s->name) != 0) ||
+      (zmsg_addstr(msg, s->value) != 0) ||
+      (zmsg_addstr(msg, version) != 0) ||
+      (zmsg_send(&msg, notify_pub) != 0)) {
+    log_error("Error publishing setting change");
+    zmsg_destroy(&msg);
+  }
+}
 
 /* Register a new setting in our linked list */
 static void settings_register(struct setting *setting)
@@ -53,13 +331,23 @@ static void settings_register(struct setting *setting)
     setting->next = s->next;
     s->next = setting;
   }
-  char buf[BUFSIZE];
-  ini_gets(setting->section, setting->name, "", buf, sizeof(buf), SETTINGS_FILE);
-  if (buf[0] != 0) {
+}
+
+/* Apply any saved value and announce the setting */
+static void settings_load(struct setting *setting)
+{
+  const char *value = NULL;
+  if (settings_store != NULL)
+    value = settings_store_get(settings_store, setting->section, setting->name);
+  else if (settings_ini != NULL)
+    value = ini_get(settings_ini, setting->section, setting->name);
+  if ((value != NULL) && (value[0] != '\0')) {
     /* Use value from config file */
-    strncpy(setting->value, buf, BUFSIZE);
+    strncpy(setting->value, value, BUFSIZE - 1);
     setting->dirty = true;
   }
+
+  settings_notify(setting);
 }
 
 /* Lookup setting in our linked list */
@@ -72,6 +360,17 @@ static struct setting *settings_lookup(const char *section, const char *setting)
   return NULL;
 }
 
+static void settings_write_pending_set(struct setting *s)
+{
+  s->write_pending_ms = zclock_mono();
+}
+
+static bool settings_write_pending(const struct setting *s)
+{
+  return (s->write_pending_ms != 0) &&
+         (zclock_mono() - s->write_pending_ms < WRITE_PENDING_TIMEOUT_ms);
+}
+
 /* Format setting into SBP message payload */
 static int settings_format_setting(struct setting *s, char *buf, int len, bool type)
 {
@@ -155,19 +454,47 @@ static void settings_register_callback(u16 sender_id, u8 len, u8 msg[], void* co
   if (!settings_parse_setting(len, msg, &section, &setting, &value, &type))
     log_error("Error in register message");
 
-  struct setting *s = calloc(1, sizeof(*s));
-  strncpy(s->section, section, BUFSIZE);
-  strncpy(s->name, setting, BUFSIZE);
+  /* Settings from the snapshot or an earlier registration keep their
+   * place in the list and are updated in place */
+  struct setting *s = settings_lookup(section, setting);
+  bool new_setting = (s == NULL);
+  if (new_setting) {
+    s = calloc(1, sizeof(*s));
+    strncpy(s->section, section, BUFSIZE);
+    strncpy(s->name, setting, BUFSIZE);
+  }
   strncpy(s->value, value, BUFSIZE);
   if (type != NULL)
     strncpy(s->type, type, BUFSIZE);
+  else
+    s->type[0] = '\0';
+  s->dirty = false;
+  s->registered = true;
 
-  settings_register(s);
+  if (new_setting)
+    settings_register(s);
+  settings_load(s);
 
   /* Reply with write message with our value */
   char buf[256];
   size_t rlen = settings_format_setting(s, buf, sizeof(buf), false);
   sbp_zmq_send_msg(context, SBP_MSG_SETTINGS_WRITE, rlen, (u8*)buf);
+  settings_write_pending_set(s);
+}
+
+static void settings_write_callback(u16 sender_id, u8 len, u8 msg[], void* context)
+{
+  (void)sender_id; (void)context;
+  const char *section = NULL, *setting = NULL, *value = NULL;
+
+  if (!settings_parse_setting(len, msg, &section, &setting, &value, NULL) ||
+      (setting == NULL))
+    return;
+
+  /* The cached value is stale until the firmware answers the write */
+  struct setting *s = settings_lookup(section, setting);
+  if (s != NULL)
+    settings_write_pending_set(s);
 }
 
 static void settings_read_reply_callback(u16 sender_id, u8 len, u8 msg[], void* context)
@@ -186,6 +513,8 @@ static void settings_read_reply_callback(u16 sender_id, u8 len, u8 msg[], void*
     return;
   }
 
+  s->write_pending_ms = 0;
+
   if (strcmp(s->value, value) == 0) {
     /* Setting unchanged */
     return;
@@ -194,10 +523,37 @@ static void settings_read_reply_callback(u16 sender_id, u8 len, u8 msg[], void*
   /* This is an assignment, call notify function */
   strncpy(s->value, value, BUFSIZE);
   s->dirty = true;
+  settings_notify(s);
 
   return;
 }
 
+static void settings_read_callback(u16 sender_id, u8 len, u8 msg[], void* context)
+{
+  (void)sender_id;
+  const char *section = NULL, *setting = NULL, *value = NULL;
+
+  if (!settings_parse_setting(len, msg, &section, &setting, &value, NULL) ||
+      (setting == NULL)) {
+    log_error("Error in read request message");
+    return;
+  }
+
+  /* The cache is kept current by read responses from the firmware, which
+   * follow every registration and write. Unknown settings, those only
+   * known from the snapshot and those with a write in progress go to the
+   * firmware, which is then responsible for the reply. */
+  struct setting *s = settings_lookup(section, setting);
+  if ((s == NULL) || !s->registered || settings_write_pending(s)) {
+    sbp_zmq_send_msg(context, SBP_MSG_SETTINGS_READ_REQ, len, msg);
+    return;
+  }
+
+  char buf[256];
+  size_t rlen = settings_format_setting(s, buf, sizeof(buf), false);
+  sbp_zmq_send_msg(context, SBP_MSG_SETTINGS_READ_RESP, rlen, (u8*)buf);
+}
+
 static void settings_read_by_index_callback(u16 sender_id, u8 len, u8 msg[], void* context)
 {
   if (sender_id != SBP_SENDER_ID) {
@@ -230,21 +586,19 @@ static void settings_read_by_index_callback(u16 sender_id, u8 len, u8 msg[], voi
   sbp_zmq_send_msg(context, SBP_MSG_SETTINGS_READ_BY_INDEX_RESP, buflen, (void*)buf);
 }
 
-static void settings_save_callback(u16 sender_id, u8 len, u8 msg[], void* context)
+/* Render settings as INI text in a malloc'd buffer */
+static int settings_render(char **buf, size_t *len, bool dirty_only)
 {
-  FILE *f = fopen(SETTINGS_FILE, "w");
-  const char *sec;
-
-  (void)sender_id; (void) context; (void)len; (void)msg;
-
+  char *data = NULL;
+  size_t size = 0;
+  FILE *f = open_memstream(&data, &size);
   if (f == NULL) {
-    perror("Error opening config file!");
-    return;
+    return -1;
   }
 
+  const char *sec = NULL;
   for (struct setting *s = settings_head; s; s = s->next) {
-    /* Skip unchanged parameters */
-    if (!s->dirty)
+    if (dirty_only && !s->dirty)
       continue;
 
     if ((sec == NULL) || (strcmp(s->section, sec) != 0)) {
@@ -252,20 +606,160 @@ static void settings_save_callback(u16 sender_id, u8 len, u8 msg[], void* contex
       sec = s->section;
       fprintf(f, "[%s]\n", sec);
     }
-
-    /* Write setting */
     fprintf(f, "%s=%s\n", s->name, s->value);
   }
 
-  fclose(f);
+  if (fclose(f) != 0) {
+    free(data);
+    return -1;
+  }
+
+  *buf = data;
+  *len = size;
+  return 0;
 }
 
-void settings_setup(sbp_state_t *sbp)
+/* Append the changes since the last save to the settings store */
+static void settings_store_save(void)
 {
+  int errors = 0;
+  for (struct setting *s = settings_head; s; s = s->next) {
+    /* Keep saved values of settings not registered yet */
+    if (!s->registered)
+      continue;
+
+    /* Only changed parameters are saved */
+    int ret;
+    if (s->dirty)
+      ret = settings_store_set(settings_store, s->section, s->name, s->value);
+    else
+      ret = settings_store_delete(settings_store, s->section, s->name);
+    if (ret != 0)
+      errors++;
+  }
+
+  if (errors > 0)
+    log_error("Error saving %d settings\n", errors);
+}
+
+static void settings_save_callback(u16 sender_id, u8 len, u8 msg[], void* context)
+{
+  (void)sender_id; (void) context; (void)len; (void)msg;
+
+  if (settings_store != NULL) {
+    settings_store_save();
+    return;
+  }
+
+  char *buf;
+  size_t buf_len;
+  /* Only changed parameters are saved */
+  if (settings_render(&buf, &buf_len, true) != 0) {
+    log_error("Error rendering config file\n");
+    return;
+  }
+
+  if (ini_file_write(SETTINGS_FILE, buf, buf_len) != 0) {
+    perror("Error writing config file!");
+    free(buf);
+    return;
+  }
+
+  /* Keep the cached config in step for settings registered again later */
+  ini_t *ini = ini_parse(buf, buf_len);
+  if (ini != NULL) {
+    ini_destroy(&settings_ini);
+    settings_ini = ini;
+  }
+  free(buf);
+}
+
+int settings_export(char **buf, size_t *len)
+{
+  return settings_render(buf, len, false);
+}
+
+int settings_import(sbp_state_t *sbp, const char *buf, size_t len)
+{
+  ini_t *ini = ini_parse(buf, len);
+  if (ini == NULL) {
+    return -1;
+  }
+
+  int count = 0;
+  for (size_t i = 0; i < ini_count(ini); i++) {
+    const char *section, *name, *value;
+    ini_entry(ini, i, &section, &name, &value);
+
+    /* Only write settings the firmware knows about, and only if they
+     * differ. The firmware answers each write with a read response,
+     * which updates the cache. */
+    struct setting *s = settings_lookup(section, name);
+    if ((s == NULL) || !s->registered || (strcmp(s->value, value) == 0))
+      continue;
+
+    char msg[256];
+    int msg_len = snprintf(msg, sizeof(msg), "%s%c%s%c%s",
+                           s->section, '\0', s->name, '\0', value) + 1;
+    if (msg_len > SBP_FRAMING_MAX_PAYLOAD_SIZE) {
+      log_error("Imported setting %s.%s too long\n", section, name);
+      continue;
+    }
+    sbp_zmq_send_msg(sbp, SBP_MSG_SETTINGS_WRITE, msg_len, (u8 *)msg);
+    settings_write_pending_set(s);
+    count++;
+  }
+
+  ini_destroy(&ini);
+  return count;
+}
+
+/* Copy the saved values from the config file into an empty store */
+static void settings_store_migrate(void)
+{
+  if ((settings_ini == NULL) || !settings_store_empty(settings_store))
+    return;
+
+  for (size_t i = 0; i < ini_count(settings_ini); i++) {
+    const char *section, *name, *value;
+    ini_entry(settings_ini, i, &section, &name, &value);
+    if (settings_store_set(settings_store, section, name, value) != 0)
+      log_error("Error migrating setting %s.%s\n", section, name);
+  }
+}
+
+void settings_setup(sbp_state_t *sbp, const char *store_spec)
+{
+  settings_loop = sbp_zmq_get_loop(sbp);
+  settings_ini = ini_load(SETTINGS_FILE);
+  if (settings_ini == NULL) {
+    log_error("Error loading config file\n");
+  }
+
+  if (store_spec != NULL) {
+    settings_store = settings_store_open(store_spec);
+    if (settings_store == NULL) {
+      log_error("Error opening settings store, using config file\n");
+    } else {
+      settings_store_migrate();
+      ini_destroy(&settings_ini);
+    }
+  }
+  settings_snapshot_load();
+
+  notify_pub = zsock_new_pub(SETTINGS_NOTIFY_ADDR);
+  if (notify_pub == NULL) {
+    log_error("Error opening settings notification socket");
+  }
+
   sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_SAVE,
                             settings_save_callback);
+  sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_READ_REQ,
+                            settings_read_callback);
   sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_READ_RESP,
                             settings_read_reply_callback);
+  sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_WRITE,
+                            settings_write_callback);
   sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_READ_BY_INDEX_REQ,
                             settings_read_by_index_callback);
   sbp_zmq_register_callback(sbp, SBP_MSG_SETTINGS_REGISTER,
@@ -15,7 +15,15 @@
 
 #include <libsbp/sbp.h>
 
-void settings_setup(sbp_state_t *);
+/* Saved settings are kept in the settings store given by store_spec if
+ * not NULL, otherwise in config.ini */
+void settings_setup(sbp_state_t *sbp, const char *store_spec);
+
+/* Render all settings as INI text in a malloc'd buffer */
+int settings_export(char **buf, size_t *len);
+/* Write the settings in an INI buffer to the firmware. Returns the number
+ * of settings changed, or -1 on error. */
+int settings_import(sbp_state_t *sbp, const char *buf, size_t len);
 
 #endif  /* SWIFTNAV_SETTINGS_H */
 
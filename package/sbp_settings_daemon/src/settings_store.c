@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <mtd/mtd-user.h>
+#include <zlib.h>
+
+#include "settings_store.h"
+
+#define log_error(...) fprintf(stderr, __VA_ARGS__)
+
+#define STORE_BLOCK_MAGIC 0x42564b53 /* "SKVB" */
+#define STORE_RECORD_MAGIC 0x5352    /* "RS" */
+#define STORE_ERASED_MAGIC 0xffff
+#define STORE_VALUE_DELETED 0xffff
+#define STORE_ALIGN 4
+#define STORE_BLOCK_COUNT_MIN 3
+
+#define STORE_FILE_SIZE (64 * 1024)
+#define STORE_FILE_BLOCK_SIZE (4 * 1024)
+
+typedef struct __attribute__((packed)) {
+  uint32_t magic;
+  uint32_t generation;
+  uint32_t crc;
+} block_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint16_t magic;
+  uint8_t key_len;
+  uint8_t reserved;
+  uint16_t value_len;
+  uint16_t reserved2;
+  /* Covers the fields above, the key and the value */
+  uint32_t crc;
+} record_header_t;
+
+typedef struct {
+  /* section, '\0', name */
+  char *key;
+  uint8_t key_len;
+  char *value;
+  bool deleted;
+  /* Block holding the latest record for the key */
+  uint32_t block;
+} entry_t;
+
+struct settings_store_s {
+  int fd;
+  bool mtd;
+  uint32_t block_size;
+  uint32_t block_count;
+  /* Generation of each block, 0 if free */
+  uint32_t *generation;
+  uint32_t next_generation;
+  uint32_t head_block;
+  uint32_t head_offset;
+  bool head_valid;
+  bool compacting;
+  entry_t *entries;
+  size_t entry_count;
+  size_t entry_capacity;
+};
+
+static uint32_t align_up(uint32_t x)
+{
+  return (x + STORE_ALIGN - 1) & ~(STORE_ALIGN - 1);
+}
+
+static int dev_read(settings_store_t *s, uint32_t block, uint32_t offset,
+                    void *buf, size_t len)
+{
+  off_t pos = (off_t)block * s->block_size + offset;
+  return (pread(s->fd, buf, len, pos) == (ssize_t)len) ? 0 : -1;
+}
+
+static int dev_write(settings_store_t *s, uint32_t block, uint32_t offset,
+                     const void *buf, size_t len)
+{
+  off_t pos = (off_t)block * s->block_size + offset;
+  return (pwrite(s->fd, buf, len, pos) == (ssize_t)len) ? 0 : -1;
+}
+
+static int dev_erase(settings_store_t *s, uint32_t block)
+{
+  if (s->mtd) {
+    struct erase_info_user erase = {
+      .start = block * s->block_size,
+      .length = s->block_size
+    };
+    return ioctl(s->fd, MEMERASE, &erase);
+  }
+
+  /* Files emulate erased flash */
+  uint8_t *ff = malloc(s->block_size);
+  if (ff == NULL) {
+    return -1;
+  }
+  memset(ff, 0xff, s->block_size);
+  int ret = dev_write(s, block, 0, ff, s->block_size);
+  free(ff);
+  return ret;
+}
+
+static int dev_open_mtd(settings_store_t *s, const char *name)
+{
+  FILE *f = fopen("/proc/mtd", "r");
+  if (f == NULL) {
+    return -1;
+  }
+
+  /* Lines are: mtd<n>: <size> <erasesize> "<name>" */
+  char line[128];
+  char path[32] = "";
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned int index;
+    char part[64];
+    if ((sscanf(line, "mtd%u: %*x %*x \"%63[^\"]\"", &index, part) == 2) &&
+        (strcmp(part, name) == 0)) {
+      snprintf(path, sizeof(path), "/dev/mtd%u", index);
+      break;
+    }
+  }
+  fclose(f);
+
+  if (path[0] == '\0') {
+    log_error("settings store: no MTD partition named %s\n", name);
+    return -1;
+  }
+
+  s->fd = open(path, O_RDWR);
+  if (s->fd < 0) {
+    return -1;
+  }
+
+  struct mtd_info_user info;
+  if (ioctl(s->fd, MEMGETINFO, &info) != 0) {
+    return -1;
+  }
+  s->mtd = true;
+  s->block_size = info.erasesize;
+  s->block_count = info.size / info.erasesize;
+  return 0;
+}
+
+static int dev_open_file(settings_store_t *s, const char *path)
+{
+  s->fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (s->fd < 0) {
+    return -1;
+  }
+
+  s->block_size = STORE_FILE_BLOCK_SIZE;
+  s->block_count = STORE_FILE_SIZE / STORE_FILE_BLOCK_SIZE;
+
+  struct stat st;
+  if (fstat(s->fd, &st) != 0) {
+    return -1;
+  }
+  if (st.st_size != STORE_FILE_SIZE) {
+    if (ftruncate(s->fd, STORE_FILE_SIZE) != 0) {
+      return -1;
+    }
+    for (uint32_t b = 0; b < s->block_count; b++) {
+      if (dev_erase(s, b) != 0) {
+        return -1;
+      }
+    }
+    fsync(s->fd);
+  }
+  return 0;
+}
+
+static entry_t *entry_find(const settings_store_t *s, const char *key,
+                           uint8_t key_len)
+{
+  for (size_t i = 0; i < s->entry_count; i++) {
+    entry_t *e = &s->entries[i];
+    if ((e->key_len == key_len) && (memcmp(e->key, key, key_len) == 0)) {
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static int entry_update(settings_store_t *s, const char *key, uint8_t key_len,
+                        const char *value, size_t value_len, bool deleted,
+                        uint32_t block)
+{
+  char *v = NULL;
+  if (!deleted) {
+    v = malloc(value_len + 1);
+    if (v == NULL) {
+      return -1;
+    }
+    memcpy(v, value, value_len);
+    v[value_len] = '\0';
+  }
+
+  entry_t *e = entry_find(s, key, key_len);
+  if (e == NULL) {
+    if (s->entry_count == s->entry_capacity) {
+      size_t capacity = (s->entry_capacity == 0) ? 64 : 2 * s->entry_capacity;
+      entry_t *entries = realloc(s->entries, capacity * sizeof(*entries));
+      if (entries == NULL) {
+        free(v);
+        return -1;
+      }
+      s->entries = entries;
+      s->entry_capacity = capacity;
+    }
+
+    e = &s->entries[s->entry_count];
+    e->key = malloc(key_len);
+    if (e->key == NULL) {
+      free(v);
+      return -1;
+    }
+    memcpy(e->key, key, key_len);
+    e->key_len = key_len;
+    e->value = NULL;
+    s->entry_count++;
+  }
+
+  free(e->value);
+  e->value = v;
+  e->deleted = deleted;
+  e->block = block;
+  return 0;
+}
+
+static void entry_remove(settings_store_t *s, entry_t *e)
+{
+  free(e->key);
+  free(e->value);
+  *e = s->entries[--s->entry_count];
+}
+
+static uint32_t record_crc(const record_header_t *header, const char *key,
+                           const char *value, size_t value_len)
+{
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef *)header, offsetof(record_header_t, crc));
+  crc = crc32(crc, (const Bytef *)key, header->key_len);
+  if (value_len > 0) {
+    crc = crc32(crc, (const Bytef *)value, value_len);
+  }
+  return crc;
+}
+
+static uint32_t block_header_crc(const block_header_t *header)
+{
+  return crc32(crc32(0L, Z_NULL, 0), (const Bytef *)header,
+               offsetof(block_header_t, crc));
+}
+
+static uint32_t free_block_count(const settings_store_t *s)
+{
+  uint32_t count = 0;
+  for (uint32_t b = 0; b < s->block_count; b++) {
+    if (s->generation[b] == 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static int append(settings_store_t *s, const char *key, uint8_t key_len,
+                  const char *value, bool deleted);
+
+/* Move the live records of the oldest block to the head and erase it.
+ * A deletion can be dropped rather than moved, as any older record for
+ * the key is in this block. */
+static int compact(settings_store_t *s)
+{
+  uint32_t oldest = s->block_count;
+  for (uint32_t b = 0; b < s->block_count; b++) {
+    if ((s->generation[b] != 0) && (b != s->head_block) &&
+        ((oldest == s->block_count) ||
+         (s->generation[b] < s->generation[oldest]))) {
+      oldest = b;
+    }
+  }
+  if (oldest == s->block_count) {
+    return -1;
+  }
+
+  s->compacting = true;
+  int ret = 0;
+  for (size_t i = 0; i < s->entry_count; ) {
+    entry_t *e = &s->entries[i];
+    if (e->block != oldest) {
+      i++;
+      continue;
+    }
+    if (e->deleted) {
+      entry_remove(s, e);
+      continue;
+    }
+    if (append(s, e->key, e->key_len, e->value, false) != 0) {
+      ret = -1;
+      break;
+    }
+    e->block = s->head_block;
+    i++;
+  }
+  s->compacting = false;
+
+  if (ret != 0) {
+    return -1;
+  }
+
+  s->generation[oldest] = 0;
+  return dev_erase(s, oldest);
+}
+
+static int head_advance(settings_store_t *s)
+{
+  /* Keep one block free for compaction to move records into */
+  for (uint32_t i = 0; !s->compacting && (free_block_count(s) <= 1); i++) {
+    if ((i == s->block_count) || (compact(s) != 0)) {
+      log_error("settings store full\n");
+      return -1;
+    }
+  }
+
+  uint32_t block = s->block_count;
+  for (uint32_t i = 1; i <= s->block_count; i++) {
+    uint32_t b = (s->head_block + i) % s->block_count;
+    if (s->generation[b] == 0) {
+      block = b;
+      break;
+    }
+  }
+  if (block == s->block_count) {
+    log_error("settings store full\n");
+    return -1;
+  }
+
+  block_header_t header = {
+    .magic = STORE_BLOCK_MAGIC,
+    .generation = s->next_generation
+  };
+  header.crc = block_header_crc(&header);
+
+  if ((dev_erase(s, block) != 0) ||
+      (dev_write(s, block, 0, &header, sizeof(header)) != 0)) {
+    log_error("settings store: error writing block %u\n", block);
+    return -1;
+  }
+
+  s->generation[block] = s->next_generation++;
+  s->head_block = block;
+  s->head_offset = sizeof(header);
+  s->head_valid = true;
+  return 0;
+}
+
+static int append(settings_store_t *s, const char *key, uint8_t key_len,
+                  const char *value, bool deleted)
+{
+  size_t value_len = deleted ? 0 : strlen(value);
+  uint32_t len = align_up(sizeof(record_header_t) + key_len + value_len);
+  if (len > s->block_size - sizeof(block_header_t)) {
+    return -1;
+  }
+
+  if (!s->head_valid || (s->head_offset + len > s->block_size)) {
+    if (head_advance(s) != 0) {
+      return -1;
+    }
+  }
+
+  uint8_t buf[len];
+  memset(buf, 0xff, len);
+  record_header_t header = {
+    .magic = STORE_RECORD_MAGIC,
+    .key_len = key_len,
+    .reserved = 0,
+    .value_len = deleted ? STORE_VALUE_DELETED : value_len,
+    .reserved2 = 0
+  };
+  header.crc = record_crc(&header, key, value, value_len);
+  memcpy(buf, &header, sizeof(header));
+  memcpy(&buf[sizeof(header)], key, key_len);
+  if (value_len > 0) {
+    memcpy(&buf[sizeof(header) + key_len], value, value_len);
+  }
+
+  if (dev_write(s, s->head_block, s->head_offset, buf, len) != 0) {
+    /* Do not write after a possibly partial record */
+    s->head_valid = false;
+    return -1;
+  }
+  s->head_offset += len;
+  return 0;
+}
+
+/* Replay the records of a block, returns the end offset of the last
+ * valid record, or 0 if the block ends with an invalid one */
+static uint32_t block_replay(settings_store_t *s, uint32_t block,
+                             uint8_t *data)
+{
+  uint32_t offset = sizeof(block_header_t);
+  while (offset + sizeof(record_header_t) <= s->block_size) {
+    record_header_t header;
+    memcpy(&header, &data[offset], sizeof(header));
+    if (header.magic == STORE_ERASED_MAGIC) {
+      return offset;
+    }
+
+    bool deleted = (header.value_len == STORE_VALUE_DELETED);
+    size_t value_len = deleted ? 0 : header.value_len;
+    uint32_t len = align_up(sizeof(header) + header.key_len + value_len);
+    if ((header.magic != STORE_RECORD_MAGIC) ||
+        (offset + len > s->block_size)) {
+      return 0;
+    }
+
+    const char *key = (const char *)&data[offset + sizeof(header)];
+    const char *value = key + header.key_len;
+    if (record_crc(&header, key, value, value_len) != header.crc) {
+      return 0;
+    }
+
+    entry_update(s, key, header.key_len, value, value_len, deleted, block);
+    offset += len;
+  }
+  return 0;
+}
+
+static int store_scan(settings_store_t *s)
+{
+  uint8_t *data = malloc(s->block_size);
+  if (data == NULL) {
+    return -1;
+  }
+
+  for (uint32_t b = 0; b < s->block_count; b++) {
+    block_header_t header;
+    if ((dev_read(s, b, 0, &header, sizeof(header)) == 0) &&
+        (header.magic == STORE_BLOCK_MAGIC) && (header.generation != 0) &&
+        (block_header_crc(&header) == header.crc)) {
+      s->generation[b] = header.generation;
+      if (header.generation >= s->next_generation) {
+        s->next_generation = header.generation + 1;
+      }
+    }
+  }
+
+  /* Replay blocks from oldest to newest */
+  uint32_t last = 0;
+  while (1) {
+    uint32_t block = s->block_count;
+    for (uint32_t b = 0; b < s->block_count; b++) {
+      if ((s->generation[b] > last) &&
+          ((block == s->block_count) ||
+           (s->generation[b] < s->generation[block]))) {
+        block = b;
+      }
+    }
+    if (block == s->block_count) {
+      break;
+    }
+    last = s->generation[block];
+
+    if (dev_read(s, block, 0, data, s->block_size) != 0) {
+      free(data);
+      return -1;
+    }
+
+    /* The newest block is the head unless it ends badly */
+    uint32_t end = block_replay(s, block, data);
+    s->head_block = block;
+    s->head_offset = end;
+    s->head_valid = (end != 0);
+  }
+
+  free(data);
+  return 0;
+}
+
+settings_store_t *settings_store_open(const char *spec)
+{
+  settings_store_t *s = calloc(1, sizeof(*s));
+  if (s == NULL) {
+    return NULL;
+  }
+  s->fd = -1;
+  s->next_generation = 1;
+
+  int ret = -1;
+  if (strncmp(spec, "mtd:", 4) == 0) {
+    ret = dev_open_mtd(s, spec + 4);
+  } else if (strncmp(spec, "file:", 5) == 0) {
+    ret = dev_open_file(s, spec + 5);
+  }
+
+  if ((ret != 0) || (s->block_count < STORE_BLOCK_COUNT_MIN)) {
+    log_error("settings store: error opening %s\n", spec);
+    settings_store_close(&s);
+    return NULL;
+  }
+
+  s->generation = calloc(s->block_count, sizeof(*s->generation));
+  if ((s->generation == NULL) || (store_scan(s) != 0)) {
+    settings_store_close(&s);
+    return NULL;
+  }
+
+  return s;
+}
+
+void settings_store_close(settings_store_t **store)
+{
+  settings_store_t *s = *store;
+  if (s == NULL) {
+    return;
+  }
+
+  while (s->entry_count > 0) {
+    entry_remove(s, &s->entries[0]);
+  }
+  free(s->entries);
+  free(s->generation);
+  if (s->fd >= 0) {
+    close(s->fd);
+  }
+  free(s);
+  *store = NULL;
+}
+
+bool settings_store_empty(const settings_store_t *s)
+{
+  for (size_t i = 0; i < s->entry_count; i++) {
+    if (!s->entries[i].deleted) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int key_make(char *key, const char *section, const char *name)
+{
+  size_t section_len = strlen(section);
+  size_t name_len = strlen(name);
+  if (section_len + 1 + name_len > UINT8_MAX) {
+    return -1;
+  }
+  memcpy(key, section, section_len + 1);
+  memcpy(&key[section_len + 1], name, name_len);
+  return section_len + 1 + name_len;
+}
+
+const char *settings_store_get(const settings_store_t *s,
+                               const char *section, const char *name)
+{
+  char key[UINT8_MAX + 1];
+  int key_len = key_make(key, section, name);
+  if (key_len < 0) {
+    return NULL;
+  }
+
+  entry_t *e = entry_find(s, key, key_len);
+  return ((e == NULL) || e->deleted) ? NULL : e->value;
+}
+
+int settings_store_set(settings_store_t *s, const char *section,
+                       const char *name, const char *value)
+{
+  char key[UINT8_MAX + 1];
+  int key_len = key_make(key, section, name);
+  if ((key_len < 0) || (strlen(value) >= STORE_VALUE_DELETED)) {
+    return -1;
+  }
+
+  entry_t *e = entry_find(s, key, key_len);
+  if ((e != NULL) && !e->deleted && (strcmp(e->value, value) == 0)) {
+    return 0;
+  }
+
+  if (append(s, key, key_len, value, false) != 0) {
+    return -1;
+  }
+  return entry_update(s, key, key_len, value, strlen(value), false,
+                      s->head_block);
+}
+
+int settings_store_delete(settings_store_t *s, const char *section,
+                          const char *name)
+{
+  char key[UINT8_MAX + 1];
+  int key_len = key_make(key, section, name);
+  if (key_len < 0) {
+    return -1;
+  }
+
+  entry_t *e = entry_find(s, key, key_len);
+  if ((e == NULL) || e->deleted) {
+    return 0;
+  }
+
+  if (append(s, key, key_len, NULL, true) != 0) {
+    return -1;
+  }
+  return entry_update(s, key, key_len, NULL, 0, true, s->head_block);
+}
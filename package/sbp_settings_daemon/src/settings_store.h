@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_SETTINGS_STORE_H
+#define SWIFTNAV_SETTINGS_STORE_H
+
+#include <stdbool.h>
+
+/* Append-only key/value log for saved settings.
+ *
+ * The backing device is divided into erase blocks used as a ring. Each
+ * block starts with a header holding a generation number, followed by
+ * CRC protected records of a section, a name and a value (or a deletion).
+ * Later records replace earlier ones. Opening the store replays the
+ * blocks in generation order, so a save only appends the changed keys.
+ * When space runs low the oldest block is compacted by copying its live
+ * records to the head and erasing it. One block is always kept free so
+ * that compaction can complete.
+ *
+ * A record that fails its CRC ends its block, and later appends start in
+ * a new block, so an interrupted write loses at most that record.
+ *
+ * Stores are opened with
+ *   "mtd:<name>"  a raw MTD partition, by name from /proc/mtd
+ *   "file:<path>" a regular file, created as 64 kB of 4 kB blocks
+ */
+typedef struct settings_store_s settings_store_t;
+
+settings_store_t *settings_store_open(const char *spec);
+void settings_store_close(settings_store_t **store);
+
+/* True if the store holds no values */
+bool settings_store_empty(const settings_store_t *store);
+
+/* Returns the saved value, or NULL if there is none */
+const char *settings_store_get(const settings_store_t *store,
+                               const char *section, const char *name);
+
+/* Save or remove a value. Unchanged values are not written. */
+int settings_store_set(settings_store_t *store, const char *section,
+                       const char *name, const char *value);
+int settings_store_delete(settings_store_t *store, const char *section,
+                          const char *name);
+
+#endif  /* SWIFTNAV_SETTINGS_STORE_H */
@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "transfer.h"
+
+#define log_error(...) fprintf(stderr, __VA_ARGS__)
+
+/* State files are named by the CRC32 of the path and contain the path
+ * on the first line followed by one "<start> <end>" line per range */
+#define TRANSFER_STATE_DIR "/var/run/sbp_fileio"
+#define TRANSFERS_MAX 16
+#define TRANSFER_EXPIRY_s 3600
+
+typedef struct {
+  /* Half open, [start, end) */
+  uint32_t start;
+  uint32_t end;
+} range_t;
+
+typedef struct {
+  bool used;
+  char path[PATH_MAX];
+  range_t *ranges;
+  size_t count;
+  size_t capacity;
+  time_t last_write;
+} transfer_t;
+
+static transfer_t transfers[TRANSFERS_MAX];
+
+static time_t now_s(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return now.tv_sec;
+}
+
+static void state_path(const char *path, char *buf, size_t len)
+{
+  uLong crc = crc32(0L, (const Bytef *)path, strlen(path));
+  snprintf(buf, len, TRANSFER_STATE_DIR "/%08lx", (unsigned long)crc);
+}
+
+static void state_save(const transfer_t *t)
+{
+  char name[PATH_MAX];
+  state_path(t->path, name, sizeof(name));
+
+  FILE *f = fopen(name, "w");
+  if (f == NULL) {
+    return;
+  }
+  fprintf(f, "%s\n", t->path);
+  for (size_t i = 0; i < t->count; i++) {
+    fprintf(f, "%u %u\n", t->ranges[i].start, t->ranges[i].end);
+  }
+  fclose(f);
+}
+
+static void transfer_free(transfer_t *t)
+{
+  char name[PATH_MAX];
+  state_path(t->path, name, sizeof(name));
+  unlink(name);
+
+  free(t->ranges);
+  memset(t, 0, sizeof(*t));
+}
+
+static transfer_t *transfer_lookup(const char *path)
+{
+  time_t now = now_s();
+  transfer_t *found = NULL;
+  for (int i = 0; i < TRANSFERS_MAX; i++) {
+    transfer_t *t = &transfers[i];
+    if (!t->used) {
+      continue;
+    }
+    if (now - t->last_write > TRANSFER_EXPIRY_s) {
+      transfer_free(t);
+      continue;
+    }
+    if (strcmp(t->path, path) == 0) {
+      found = t;
+    }
+  }
+  return found;
+}
+
+static transfer_t *transfer_new(const char *path)
+{
+  /* Take a free slot, or the least recently written */
+  transfer_t *t = &transfers[0];
+  for (int i = 0; i < TRANSFERS_MAX; i++) {
+    if (!transfers[i].used) {
+      t = &transfers[i];
+      break;
+    }
+    if (transfers[i].last_write < t->last_write) {
+      t = &transfers[i];
+    }
+  }
+
+  if (t->used) {
+    transfer_free(t);
+  }
+  t->used = true;
+  strncpy(t->path, path, sizeof(t->path) - 1);
+  t->last_write = now_s();
+  return t;
+}
+
+/* Add [start, end) to the sorted list, merging overlapping or adjacent
+ * ranges. Uploads are mostly sequential so the list stays short. */
+static bool range_add(transfer_t *t, uint32_t start, uint32_t end)
+{
+  size_t i = 0;
+  while ((i < t->count) && (t->ranges[i].end < start)) {
+    i++;
+  }
+
+  /* Ranges from i to j - 1 touch the new one */
+  size_t j = i;
+  while ((j < t->count) && (t->ranges[j].start <= end)) {
+    if (t->ranges[j].start < start) {
+      start = t->ranges[j].start;
+    }
+    if (t->ranges[j].end > end) {
+      end = t->ranges[j].end;
+    }
+    j++;
+  }
+
+  if (j == i) {
+    if (t->count == t->capacity) {
+      size_t capacity = (t->capacity == 0) ? 8 : 2 * t->capacity;
+      range_t *ranges = realloc(t->ranges, capacity * sizeof(*ranges));
+      if (ranges == NULL) {
+        return false;
+      }
+      t->ranges = ranges;
+      t->capacity = capacity;
+    }
+    memmove(&t->ranges[i + 1], &t->ranges[i],
+            (t->count - i) * sizeof(*t->ranges));
+    t->count++;
+  } else {
+    memmove(&t->ranges[i + 1], &t->ranges[j],
+            (t->count - j) * sizeof(*t->ranges));
+    t->count -= j - i - 1;
+  }
+
+  t->ranges[i] = (range_t) { .start = start, .end = end };
+  return true;
+}
+
+static void state_load(const char *name, time_t mtime)
+{
+  FILE *f = fopen(name, "r");
+  if (f == NULL) {
+    return;
+  }
+
+  char path[PATH_MAX];
+  if ((fgets(path, sizeof(path), f) != NULL) &&
+      (strlen(path) > 1) && (path[strlen(path) - 1] == '\n')) {
+    path[strlen(path) - 1] = '\0';
+
+    transfer_t *t = transfer_new(path);
+    t->last_write = mtime;
+    unsigned int start, end;
+    while (fscanf(f, "%u %u", &start, &end) == 2) {
+      if ((start < end) && !range_add(t, start, end)) {
+        break;
+      }
+    }
+  }
+
+  fclose(f);
+}
+
+void transfer_setup(void)
+{
+  mkdir(TRANSFER_STATE_DIR, 0755);
+
+  DIR *dir = opendir(TRANSFER_STATE_DIR);
+  if (dir == NULL) {
+    log_error("Error opening " TRANSFER_STATE_DIR "\n");
+    return;
+  }
+
+  time_t now = now_s();
+  struct dirent *dirent;
+  while ((dirent = readdir(dir)) != NULL) {
+    if (dirent->d_name[0] == '.') {
+      continue;
+    }
+
+    char name[PATH_MAX];
+    snprintf(name, sizeof(name), TRANSFER_STATE_DIR "/%s", dirent->d_name);
+    struct stat st;
+    if (stat(name, &st) != 0) {
+      continue;
+    }
+    if (now - st.st_mtime > TRANSFER_EXPIRY_s) {
+      unlink(name);
+      continue;
+    }
+    state_load(name, st.st_mtime);
+  }
+
+  closedir(dir);
+}
+
+void transfer_write(const char *path, uint32_t offset, uint32_t length)
+{
+  if (length == 0) {
+    return;
+  }
+
+  transfer_t *t = transfer_lookup(path);
+  if (t == NULL) {
+    t = transfer_new(path);
+  }
+
+  uint32_t end = (offset > UINT32_MAX - length) ? UINT32_MAX : offset + length;
+  size_t count = t->count;
+
+  /* Ranges of an earlier upload no longer describe the file */
+  bool restart = (offset == 0) && (t->count > 0) && (t->ranges[0].start == 0);
+  if (restart) {
+    t->count = 0;
+  }
+  range_add(t, offset, end);
+  t->last_write = now_s();
+
+  /* Sequential writes only extend the last range, so there is nothing
+   * new worth saving until the number of ranges changes. The state is
+   * also saved periodically so that the recorded extent stays close. */
+  static unsigned int writes;
+  if (restart || (t->count != count) || ((++writes % 64) == 0)) {
+    state_save(t);
+  }
+}
+
+void transfer_truncate(const char *path, uint32_t size)
+{
+  transfer_t *t = transfer_lookup(path);
+  if ((t == NULL) || (t->count == 0) ||
+      (t->ranges[t->count - 1].end <= size)) {
+    return;
+  }
+
+  while ((t->count > 0) && (t->ranges[t->count - 1].start >= size)) {
+    t->count--;
+  }
+  if ((t->count > 0) && (t->ranges[t->count - 1].end > size)) {
+    t->ranges[t->count - 1].end = size;
+  }
+  state_save(t);
+}
+
+void transfer_remove(const char *path)
+{
+  transfer_t *t = transfer_lookup(path);
+  if (t != NULL) {
+    transfer_free(t);
+  }
+}
+
+int transfer_missing(const char *path, uint32_t size, char **buf,
+                     size_t *len)
+{
+  char *data = NULL;
+  size_t data_len = 0;
+  FILE *f = open_memstream(&data, &data_len);
+  if (f == NULL) {
+    return -1;
+  }
+
+  transfer_t *t = transfer_lookup(path);
+  uint32_t pos = 0;
+  if ((t == NULL) && (size == 0)) {
+    fprintf(f, "unknown\n");
+  } else if (t != NULL) {
+    for (size_t i = 0; i < t->count; i++) {
+      if ((size != 0) && (t->ranges[i].start >= size)) {
+        break;
+      }
+      if (t->ranges[i].start > pos) {
+        fprintf(f, "%u %u\n", pos, t->ranges[i].start - pos);
+      }
+      pos = t->ranges[i].end;
+    }
+  }
+  if (size > pos) {
+    fprintf(f, "%u %u\n", pos, size - pos);
+  }
+
+  if (fclose(f) != 0) {
+    free(data);
+    return -1;
+  }
+
+  *buf = data;
+  *len = data_len;
+  return 0;
+}
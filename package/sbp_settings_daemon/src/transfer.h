@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Gareth McMullin <gareth@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_TRANSFER_H
+#define SWIFTNAV_TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tracks which byte ranges of files being uploaded through fileio have
+ * been written, so that an interrupted upload can be resumed. The state
+ * is kept in tmpfs so that it survives a daemon restart, and is dropped
+ * when the file is removed or no write has arrived for an hour. */
+
+void transfer_setup(void);
+
+/* Record a successful write. A write at offset 0 when the start of the
+ * file was already written begins a new upload and forgets the old one. */
+void transfer_write(const char *path, uint32_t offset, uint32_t length);
+/* Forget ranges beyond size, e.g. after the file was truncated */
+void transfer_truncate(const char *path, uint32_t size);
+/* Forget a file */
+void transfer_remove(const char *path);
+
+/* Render the ranges of path not yet written as "<offset> <length>\n"
+ * lines in a malloc'd buffer. With a size of 0 only gaps before the last
+ * byte written are listed. A file that is not being tracked is reported
+ * as entirely missing, or as "unknown\n" with a size of 0, so that it is
+ * not mistaken for a completed upload. */
+int transfer_missing(const char *path, uint32_t size, char **buf,
+                     size_t *len);
+
+#endif  /* SWIFTNAV_TRANSFER_H */
@@ -0,0 +1,19 @@
+################################################################################
+#
+# sd_flush
+#
+################################################################################
+
+SD_FLUSH_VERSION = 0.1
+SD_FLUSH_SITE = "${BR2_EXTERNAL}/package/sd_flush/src"
+SD_FLUSH_SITE_METHOD = local
+
+define SD_FLUSH_BUILD_CMDS
+    $(MAKE) CC=$(TARGET_CC) LD=$(TARGET_LD) -C $(@D) all
+endef
+
+define SD_FLUSH_INSTALL_TARGET_CMDS
+    $(INSTALL) -D -m 0755 $(@D)/sd_flush $(TARGET_DIR)/usr/bin
+endef
+
+$(eval $(generic-package))
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* syncfs() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <mntent.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Removable media are mounted without -o sync, so writes are only cached.
+ * This daemon writes them back to the card periodically, immediately on
+ * SIGUSR1, and before exiting on SIGTERM or SIGINT at shutdown.
+ *
+ * Writers that need their data on the card at a given point should call
+ * fsync() on their files, or run "sd_flush --now", which returns once
+ * every mounted card has been flushed. */
+
+#define MEDIA_DIR_DEFAULT "/media"
+#define INTERVAL_DEFAULT_ms 5000
+
+static bool debug = false;
+static bool flush_now = false;
+static const char *media_dir = MEDIA_DIR_DEFAULT;
+static uint32_t interval_ms = INTERVAL_DEFAULT_ms;
+
+static void debug_printf(const char *msg, ...)
+{
+  if (!debug) {
+    return;
+  }
+
+  va_list ap;
+  va_start(ap, msg);
+  vprintf(msg, ap);
+  va_end(ap);
+}
+
+static void usage(char *command)
+{
+  printf("Usage: %s [options]\n", command);
+
+  puts("\nFlush options");
+  puts("\t--dir <dir>");
+  puts("\t\tflush file systems mounted below <dir>, default " MEDIA_DIR_DEFAULT);
+  puts("\t--interval <ms>");
+  puts("\t\ttime between periodic flushes");
+  puts("\t--now");
+  puts("\t\tflush once and exit");
+
+  puts("\nMisc options");
+  puts("\t--debug");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_DIR = 1,
+    OPT_ID_INTERVAL,
+    OPT_ID_NOW,
+    OPT_ID_DEBUG
+  };
+
+  const struct option long_opts[] = {
+    {"dir",      required_argument, 0, OPT_ID_DIR},
+    {"interval", required_argument, 0, OPT_ID_INTERVAL},
+    {"now",      no_argument,       0, OPT_ID_NOW},
+    {"debug",    no_argument,       0, OPT_ID_DEBUG},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case OPT_ID_DIR: {
+        media_dir = optarg;
+      }
+      break;
+
+      case OPT_ID_INTERVAL: {
+        interval_ms = strtoul(optarg, NULL, 10);
+      }
+      break;
+
+      case OPT_ID_NOW: {
+        flush_now = true;
+      }
+      break;
+
+      case OPT_ID_DEBUG: {
+        debug = true;
+      }
+      break;
+
+      default: {
+        printf("invalid option\n");
+        return -1;
+      }
+      break;
+    }
+  }
+
+  if (interval_ms == 0) {
+    printf("invalid interval\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+static bool below_media_dir(const char *path)
+{
+  size_t len = strlen(media_dir);
+  return (strncmp(path, media_dir, len) == 0) && (path[len] == '/');
+}
+
+/* Write back each file system mounted below media_dir. syncfs() is used
+ * rather than sync() so that other devices are left alone. */
+static int flush(void)
+{
+  FILE *mounts = setmntent("/proc/mounts", "r");
+  if (mounts == NULL) {
+    printf("error opening /proc/mounts\n");
+    return -1;
+  }
+
+  int ret = 0;
+  struct mntent *ent;
+  while ((ent = getmntent(mounts)) != NULL) {
+    if (!below_media_dir(ent->mnt_dir)) {
+      continue;
+    }
+
+    int fd = open(ent->mnt_dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+      continue;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (syncfs(fd) != 0) {
+      printf("error flushing %s: %s\n", ent->mnt_dir, strerror(errno));
+      ret = -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(fd);
+
+    debug_printf("flushed %s in %ld ms\n", ent->mnt_dir,
+                 (long)((end.tv_sec - start.tv_sec) * 1000 +
+                        (end.tv_nsec - start.tv_nsec) / 1000000));
+  }
+
+  endmntent(mounts);
+  return ret;
+}
+
+int main(int argc, char *argv[])
+{
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  if (flush_now) {
+    return (flush() == 0) ? 0 : 1;
+  }
+
+  /* Signals are only taken from sigtimedwait() */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  sigaddset(&signals, SIGTERM);
+  sigaddset(&signals, SIGINT);
+  sigprocmask(SIG_BLOCK, &signals, NULL);
+
+  const struct timespec interval = {
+    .tv_sec = interval_ms / 1000,
+    .tv_nsec = (interval_ms % 1000) * 1000000
+  };
+
+  while (1) {
+    int sig = sigtimedwait(&signals, NULL, &interval);
+    if ((sig < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+      printf("sigtimedwait() error: %s\n", strerror(errno));
+    }
+
+    flush();
+
+    if ((sig == SIGTERM) || (sig == SIGINT)) {
+      break;
+    }
+  }
+
+  return 0;
+}
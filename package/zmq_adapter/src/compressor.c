@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "compressor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef LZ4F_HEADER_SIZE_MAX
+#define LZ4F_HEADER_SIZE_MAX 19
+#endif
+
+/* Linked blocks let each flush refer back to the previous 64 kB of the
+ * stream, which is where most of the redundancy in SBP lies */
+static const LZ4F_preferences_t lz4_preferences = {
+  .frameInfo = {
+    .blockSizeID = LZ4F_max64KB,
+    .blockMode = LZ4F_blockLinked,
+    .contentChecksumFlag = LZ4F_noContentChecksum,
+    .frameType = LZ4F_frame
+  },
+  .compressionLevel = 0,
+  .autoFlush = 1
+};
+
+int compressor_state_init(compressor_state_t *s, compressor_t compressor,
+                          size_t input_size_max)
+{
+  memset(s, 0, sizeof(*s));
+  s->compressor = compressor;
+  s->input_size_max = input_size_max;
+
+  if (compressor == COMPRESSOR_NONE) {
+    return 0;
+  }
+
+  LZ4F_errorCode_t error =
+      LZ4F_createCompressionContext(&s->lz4_ctx, LZ4F_VERSION);
+  if (LZ4F_isError(error)) {
+    printf("LZ4F_createCompressionContext() error: %s\n",
+           LZ4F_getErrorName(error));
+    return -1;
+  }
+
+  s->buffer_size = LZ4F_HEADER_SIZE_MAX +
+                   LZ4F_compressBound(input_size_max, &lz4_preferences);
+  s->buffer = malloc(s->buffer_size);
+  if (s->buffer == NULL) {
+    LZ4F_freeCompressionContext(s->lz4_ctx);
+    return -1;
+  }
+
+  return 0;
+}
+
+void compressor_state_deinit(compressor_state_t *s)
+{
+  if (s->compressor == COMPRESSOR_NONE) {
+    return;
+  }
+
+  LZ4F_freeCompressionContext(s->lz4_ctx);
+  free(s->buffer);
+  s->buffer = NULL;
+}
+
+ssize_t compressor_process(compressor_state_t *s,
+                           const uint8_t *data, size_t data_length,
+                           const uint8_t **output)
+{
+  if (s->compressor == COMPRESSOR_NONE) {
+    *output = data;
+    return data_length;
+  }
+
+  if (data_length > s->input_size_max) {
+    return -1;
+  }
+
+  size_t output_length = 0;
+
+  /* Frame header is sent ahead of the first data */
+  if (!s->lz4_started) {
+    size_t ret = LZ4F_compressBegin(s->lz4_ctx, s->buffer, s->buffer_size,
+                                    &lz4_preferences);
+    if (LZ4F_isError(ret)) {
+      printf("LZ4F_compressBegin() error: %s\n", LZ4F_getErrorName(ret));
+      return -1;
+    }
+    output_length += ret;
+    s->lz4_started = true;
+  }
+
+  size_t ret = LZ4F_compressUpdate(s->lz4_ctx, &s->buffer[output_length],
+                                   s->buffer_size - output_length,
+                                   data, data_length, NULL);
+  if (LZ4F_isError(ret)) {
+    printf("LZ4F_compressUpdate() error: %s\n", LZ4F_getErrorName(ret));
+    return -1;
+  }
+  output_length += ret;
+
+  /* Nothing should remain buffered with autoFlush, but make sure */
+  ret = LZ4F_flush(s->lz4_ctx, &s->buffer[output_length],
+                   s->buffer_size - output_length, NULL);
+  if (LZ4F_isError(ret)) {
+    printf("LZ4F_flush() error: %s\n", LZ4F_getErrorName(ret));
+    return -1;
+  }
+  output_length += ret;
+
+  *output = s->buffer;
+  return output_length;
+}
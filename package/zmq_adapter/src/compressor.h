@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_COMPRESSOR_H
+#define SWIFTNAV_COMPRESSOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <lz4frame.h>
+
+typedef enum {
+  COMPRESSOR_NONE,
+  COMPRESSOR_LZ4
+} compressor_t;
+
+typedef struct {
+  compressor_t compressor;
+  size_t input_size_max;
+  uint8_t *buffer;
+  size_t buffer_size;
+  LZ4F_compressionContext_t lz4_ctx;
+  bool lz4_started;
+} compressor_state_t;
+
+int compressor_state_init(compressor_state_t *s, compressor_t compressor,
+                          size_t input_size_max);
+void compressor_state_deinit(compressor_state_t *s);
+
+/* Compress data and flush, so that the output can be decoded completely
+ * without waiting for further input. Returns the output length or -1. */
+ssize_t compressor_process(compressor_state_t *s,
+                           const uint8_t *data, size_t data_length,
+                           const uint8_t **output);
+
+#endif /* SWIFTNAV_COMPRESSOR_H */
@@ -10,15 +10,26 @@
  * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* splice(), tee() */
+#endif
+
 #include "zmq_adapter.h"
 #include "framer.h"
+#include "compressor.h"
 
 #include <getopt.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
+#include <daemon_util.h>
 
 #define READ_BUFFER_SIZE 65536
 #define REP_TIMEOUT_DEFAULT_ms 10000
 #define ZSOCK_RESTART_RETRY_COUNT 3
 #define ZSOCK_RESTART_RETRY_DELAY_ms 1
+#define SPLICE_CHUNK_SIZE 65536
 
 typedef enum {
   IO_INVALID,
@@ -36,6 +47,9 @@ typedef enum {
 typedef struct {
   zsock_t *zsock;
   int fd;
+  bool batch;
+  zmsg_t *pending_msg;
+  compressor_state_t *compressor_state;
 } handle_t;
 
 typedef ssize_t (*read_fn_t)(handle_t *handle, void *buffer, size_t count);
@@ -43,9 +57,11 @@ typedef ssize_t (*write_fn_t)(handle_t *handle, const void *buffer,
                               size_t count);
 
 static bool debug = false;
+static bool batch = false;
 static io_mode_t io_mode = IO_INVALID;
 static zsock_mode_t zsock_mode = ZSOCK_INVALID;
 static framer_t framer = FRAMER_NONE;
+static compressor_t compressor = COMPRESSOR_NONE;
 static int rep_timeout_ms = REP_TIMEOUT_DEFAULT_ms;
 
 static const char *zmq_pub_addr = NULL;
@@ -53,6 +69,7 @@ static const char *zmq_sub_addr = NULL;
 static const char *zmq_req_addr = NULL;
 static const char *zmq_rep_addr = NULL;
 static const char *file_path = NULL;
+static const char *splice_path = NULL;
 static int tcp_listen_port = -1;
 
 static void debug_printf(const char *msg, ...)
@@ -85,14 +102,28 @@ static void usage(char *command)
   puts("\t-f, --framer <framer>");
   puts("\t\tavailable framers: sbp");
 
+  puts("\nCompression Mode - optional");
+  puts("\t--compress <compressor>");
+  puts("\t\tcompress data written to IO from --sub");
+  puts("\t\tavailable compressors: lz4");
+
   puts("\nIO Modes - select one");
   puts("\t--file <file>");
   puts("\t--tcp-l <port>");
 
+  puts("\nPassthrough Mode - optional");
+  puts("\t--splice <file>");
+  puts("\t\tbridge IO directly to <file> without ZMQ");
+  puts("\t\tmay be combined with --pub to tap data read from IO");
+
   puts("\nMisc options");
   puts("\t--rep-timeout <ms>");
   puts("\t\tresponse timeout before resetting a REP socket");
+  puts("\t--batch");
+  puts("\t\tcoalesce queued SUB messages into a single write");
   puts("\t--debug");
+
+  daemon_usage();
 }
 
 static int parse_options(int argc, char *argv[])
@@ -100,7 +131,10 @@ static int parse_options(int argc, char *argv[])
   enum {
     OPT_ID_FILE = 1,
     OPT_ID_TCP_LISTEN,
+    OPT_ID_SPLICE,
+    OPT_ID_COMPRESS,
     OPT_ID_REP_TIMEOUT,
+    OPT_ID_BATCH,
     OPT_ID_DEBUG
   };
 
@@ -112,7 +146,11 @@ static int parse_options(int argc, char *argv[])
     {"framer",      required_argument, 0, 'f'},
     {"file",        required_argument, 0, OPT_ID_FILE},
     {"tcp-l",       required_argument, 0, OPT_ID_TCP_LISTEN},
+    {"splice",      required_argument, 0, OPT_ID_SPLICE},
+    {"compress",    required_argument, 0, OPT_ID_COMPRESS},
     {"rep-timeout", required_argument, 0, OPT_ID_REP_TIMEOUT},
+    {"batch",       no_argument,       0, OPT_ID_BATCH},
+    DAEMON_LONG_OPTS,
     {"debug",       no_argument,       0, OPT_ID_DEBUG},
     {0, 0, 0, 0}
   };
@@ -134,11 +172,31 @@ static int parse_options(int argc, char *argv[])
       }
       break;
 
+      case OPT_ID_SPLICE: {
+        splice_path = optarg;
+      }
+      break;
+
+      case OPT_ID_COMPRESS: {
+        if (strcasecmp(optarg, "LZ4") == 0) {
+          compressor = COMPRESSOR_LZ4;
+        } else {
+          printf("invalid compressor\n");
+          return -1;
+        }
+      }
+      break;
+
       case OPT_ID_REP_TIMEOUT: {
         rep_timeout_ms = strtol(optarg, NULL, 10);
       }
       break;
 
+      case OPT_ID_BATCH: {
+        batch = true;
+      }
+      break;
+
       case OPT_ID_DEBUG: {
         debug = true;
       }
@@ -179,8 +237,9 @@ static int parse_options(int argc, char *argv[])
       break;
 
       default: {
-        printf("invalid option\n");
-        return -1;
+        if (daemon_option(c, optarg) != 0) {
+          return -1;
+        }
       }
       break;
     }
@@ -191,11 +250,23 @@ static int parse_options(int argc, char *argv[])
     return 1;
   }
 
-  if (zsock_mode == ZSOCK_INVALID) {
+  if (splice_path != NULL) {
+    if ((zmq_sub_addr != NULL) ||
+        (zsock_mode == ZSOCK_REQ) || (zsock_mode == ZSOCK_REP)) {
+      printf("only --pub may be combined with --splice\n");
+      return 1;
+    }
+  } else if (zsock_mode == ZSOCK_INVALID) {
     printf("ZMQ address(es) not specified\n");
     return 1;
   }
 
+  if ((compressor != COMPRESSOR_NONE) &&
+      ((zmq_sub_addr == NULL) || (splice_path != NULL))) {
+    printf("--compress requires --sub and may not be combined with --splice\n");
+    return 1;
+  }
+
   return 0;
 }
 
@@ -288,13 +359,8 @@ static void zsock_restart(zsock_t **p_zsock)
   } while ((*p_zsock == NULL) && (--retry > 0));
 }
 
-static ssize_t zsock_read(zsock_t *zsock, void *buffer, size_t count)
+static size_t zmsg_read(zmsg_t *msg, void *buffer, size_t count)
 {
-  zmsg_t *msg = zmsg_recv(zsock);
-  if (msg == NULL) {
-    return -1;
-  }
-
   size_t buffer_index = 0;
   zframe_t *frame = zmsg_first(msg);
   while (frame != NULL) {
@@ -312,12 +378,65 @@ static ssize_t zsock_read(zsock_t *zsock, void *buffer, size_t count)
     frame = zmsg_next(msg);
   }
 
+  return buffer_index;
+}
+
+static ssize_t zsock_read(zsock_t *zsock, void *buffer, size_t count)
+{
+  zmsg_t *msg = zmsg_recv(zsock);
+  if (msg == NULL) {
+    return -1;
+  }
+
+  size_t buffer_index = zmsg_read(msg, buffer, count);
+
   zmsg_destroy(&msg);
   assert(msg == NULL);
 
   return buffer_index;
 }
 
+static ssize_t zsock_read_batch(handle_t *handle, void *buffer, size_t count)
+{
+  size_t buffer_index = 0;
+
+  /* Block until at least one message is available */
+  zmsg_t *msg = handle->pending_msg;
+  handle->pending_msg = NULL;
+  if (msg == NULL) {
+    msg = zmsg_recv(handle->zsock);
+    if (msg == NULL) {
+      return -1;
+    }
+  }
+
+  while (1) {
+    buffer_index += zmsg_read(msg, &((uint8_t *)buffer)[buffer_index],
+                              count - buffer_index);
+    zmsg_destroy(&msg);
+    assert(msg == NULL);
+
+    /* Drain any messages which are already queued without blocking */
+    if (!(zsock_events(handle->zsock) & ZMQ_POLLIN)) {
+      break;
+    }
+
+    msg = zmsg_recv(handle->zsock);
+    if (msg == NULL) {
+      break;
+    }
+
+    /* Hold on to a message which does not fit until the next read */
+    if (buffer_index + zmsg_content_size(msg) > count) {
+      handle->pending_msg = msg;
+      break;
+    }
+  }
+
+  debug_printf("batched %zu bytes\n", buffer_index);
+  return buffer_index;
+}
+
 static ssize_t zsock_write(zsock_t *zsock, const void *buffer, size_t count)
 {
   int result;
@@ -344,17 +463,56 @@ static ssize_t zsock_write(zsock_t *zsock, const void *buffer, size_t count)
 
 static ssize_t handle_read(handle_t *handle, void *buffer, size_t count)
 {
-  if (handle->zsock != NULL) {
+  if ((handle->zsock != NULL) && handle->batch) {
+    return zsock_read_batch(handle, buffer, count);
+  } else if (handle->zsock != NULL) {
     return zsock_read(handle->zsock, buffer, count);
   } else {
     return read(handle->fd, buffer, count);
   }
 }
 
+static ssize_t fd_write_all(int fd, const void *buffer, size_t count)
+{
+  size_t buffer_index = 0;
+  while (buffer_index < count) {
+    ssize_t write_count = write(fd, &((uint8_t *)buffer)[buffer_index],
+                                count - buffer_index);
+    if (write_count <= 0) {
+      return write_count;
+    }
+    buffer_index += write_count;
+  }
+  return buffer_index;
+}
+
+static ssize_t compressed_write(handle_t *handle,
+                                const void *buffer, size_t count)
+{
+  const uint8_t *output;
+  ssize_t output_length = compressor_process(handle->compressor_state,
+                                             buffer, count, &output);
+  if (output_length < 0) {
+    return -1;
+  }
+
+  /* The compressor stream can not be resumed part way through an output
+   * block, so the whole block must be written before continuing */
+  ssize_t write_count = fd_write_all(handle->fd, output, output_length);
+  if (write_count != output_length) {
+    return -1;
+  }
+
+  debug_printf("compressed %zu bytes to %zd\n", count, output_length);
+  return count;
+}
+
 static ssize_t handle_write(handle_t *handle, const void *buffer, size_t count)
 {
   if (handle->zsock != NULL) {
     return zsock_write(handle->zsock, buffer, count);
+  } else if (handle->compressor_state != NULL) {
+    return compressed_write(handle, buffer, count);
   } else {
     return write(handle->fd, buffer, count);
   }
@@ -472,6 +630,10 @@ static void io_loop_pubsub(handle_t *read_handle, handle_t *write_handle,
                            framer_t framer)
 {
   debug_printf("io loop begin\n");
+  /* Memory locks are not inherited across fork() */
+  if (daemon_memory_lock() != 0) {
+    return;
+  }
 
   framer_state_t framer_state;
   framer_state_init(&framer_state, framer);
@@ -506,6 +668,10 @@ static void io_loop_reqrep(handle_t *req_handle, framer_t req_framer,
                            handle_t *rep_handle, framer_t rep_framer)
 {
   debug_printf("io loop begin\n");
+  /* Memory locks are not inherited across fork() */
+  if (daemon_memory_lock() != 0) {
+    return;
+  }
 
   framer_state_t req_framer_state;
   framer_state_init(&req_framer_state, req_framer);
@@ -608,8 +774,179 @@ static void io_loop_reqrep(handle_t *req_handle, framer_t req_framer,
   debug_printf("io loop end\n");
 }
 
+static void io_loop_splice(int read_fd, int write_fd, int tap_fd)
+{
+  debug_printf("splice loop begin\n");
+  /* Memory locks are not inherited across fork() */
+  if (daemon_memory_lock() != 0) {
+    return;
+  }
+
+  int pipe_fds[2];
+  if (pipe(pipe_fds) != 0) {
+    printf("error creating pipe\n");
+    return;
+  }
+
+  while (1) {
+    /* Move data from read_fd into the pipe */
+    ssize_t count = splice(read_fd, NULL, pipe_fds[1], NULL,
+                           SPLICE_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+    debug_printf("spliced %zd bytes\n", count);
+    if (count <= 0) {
+      if (count < 0) {
+        printf("splice error: %s\n", strerror(errno));
+      }
+      break;
+    }
+
+    /* Duplicate pipe contents into the tap pipe without consuming them.
+     * The tap is best effort and must never stall the bridge: data which
+     * does not fit in the tap pipe is dropped. */
+    if (tap_fd >= 0) {
+      ssize_t tee_count = tee(pipe_fds[0], tap_fd, count, SPLICE_F_NONBLOCK);
+      if ((tee_count < 0) && (errno != EAGAIN)) {
+        debug_printf("tap closed\n");
+        tap_fd = -1;
+      }
+    }
+
+    /* Drain the pipe into write_fd */
+    while (count > 0) {
+      ssize_t write_count = splice(pipe_fds[0], NULL, write_fd, NULL, count,
+                                   SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (write_count <= 0) {
+        if (write_count < 0) {
+          printf("splice error: %s\n", strerror(errno));
+        }
+        goto done;
+      }
+      count -= write_count;
+    }
+  }
+
+done:
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  debug_printf("splice loop end\n");
+}
+
+static void io_loop_splice_tap(int tap_fd)
+{
+  zsock_t *pub = zsock_start(ZMQ_PUB);
+  if (pub != NULL) {
+    handle_t tap_handle = {.zsock = NULL, .fd = tap_fd};
+    handle_t pub_handle = {.zsock = pub, .fd = -1};
+    io_loop_pubsub(&tap_handle, &pub_handle, framer);
+    zsock_destroy(&pub);
+    assert(pub == NULL);
+  }
+}
+
+static void io_loop_splice_session(int fd)
+{
+  /* Wait for specific children below */
+  signal(SIGCHLD, SIG_DFL);
+
+  int splice_fd = open(splice_path, O_RDWR);
+  if (splice_fd < 0) {
+    printf("error opening splice file\n");
+    return;
+  }
+
+  /* Only one session may own the splice file at a time, otherwise
+   * concurrent clients would interleave their data. The lock is shared
+   * with the bridge children and released once they have all exited. */
+  if (flock(splice_fd, LOCK_EX | LOCK_NB) != 0) {
+    printf("splice file busy, rejecting client\n");
+    close(splice_fd);
+    return;
+  }
+
+  int tap_fds[2] = {-1, -1};
+  if ((zmq_pub_addr != NULL) && (pipe(tap_fds) != 0)) {
+    printf("error creating tap pipe\n");
+  }
+
+  /* The tap reads the teed data in its own process so that the bridge
+   * never touches the data in user space */
+  if ((tap_fds[0] >= 0) && (fork() == 0)) {
+    /* child process */
+    close(tap_fds[1]);
+    close(splice_fd);
+    /* Do not hold the client connection open */
+    close(fd);
+    io_loop_splice_tap(tap_fds[0]);
+    close(tap_fds[0]);
+    return;
+  }
+
+  pid_t pids[2];
+
+  pids[0] = fork();
+  if (pids[0] == 0) {
+    /* child process */
+    close(tap_fds[0]);
+    io_loop_splice(fd, splice_fd, tap_fds[1]);
+    close(tap_fds[1]);
+    close(splice_fd);
+    return;
+  }
+
+  pids[1] = fork();
+  if (pids[1] == 0) {
+    /* child process */
+    close(tap_fds[0]);
+    close(tap_fds[1]);
+    io_loop_splice(splice_fd, fd, -1);
+    close(splice_fd);
+    return;
+  }
+
+  if (tap_fds[0] >= 0) {
+    close(tap_fds[0]);
+    close(tap_fds[1]);
+  }
+  close(splice_fd);
+  splice_fd = -1;
+
+  /* When either direction ends, stop the other. SIGKILL is used since the
+   * terminating signals are forwarded to the whole process group. The tap
+   * may exit first, e.g. if its socket fails, without ending the bridge. */
+  pid_t pid;
+  do {
+    pid = waitpid(-1, NULL, 0);
+  } while (((pid < 0) && (errno == EINTR)) ||
+           ((pid > 0) && (pid != pids[0]) && (pid != pids[1])));
+
+  for (int i = 0; i < 2; i++) {
+    if ((pids[i] > 0) && (pids[i] != pid)) {
+      kill(pids[i], SIGKILL);
+    }
+  }
+
+  /* The tap sees end of file once the bridge has exited */
+  while ((waitpid(-1, NULL, 0) >= 0) || (errno == EINTR)) {
+    ;
+  }
+}
+
+static void io_loop_splice_start(int fd)
+{
+  if (fork() == 0) {
+    /* child process */
+    io_loop_splice_session(fd);
+  }
+}
+
 void io_loop_start(int fd)
 {
+  if (splice_path != NULL) {
+    io_loop_splice_start(fd);
+    return;
+  }
+
   switch (zsock_mode) {
     case ZSOCK_PUBSUB: {
 
@@ -632,11 +969,23 @@ void io_loop_start(int fd)
         if (fork() == 0) {
           /* child process */
           zsock_t *sub = zsock_start(ZMQ_SUB);
-          if (sub != NULL) {
-            handle_t sub_handle = {.zsock = sub, .fd = -1};
-            handle_t fd_handle = {.zsock = NULL, .fd = fd};
+          compressor_state_t compressor_state;
+          if ((sub != NULL) &&
+              (compressor_state_init(&compressor_state, compressor,
+                                     READ_BUFFER_SIZE) == 0)) {
+            handle_t sub_handle = {.zsock = sub, .fd = -1, .batch = batch};
+            handle_t fd_handle = {
+              .zsock = NULL,
+              .fd = fd,
+              .compressor_state = (compressor == COMPRESSOR_NONE) ?
+                                  NULL : &compressor_state
+            };
             /* SUB loop should never need a framer */
             io_loop_pubsub(&sub_handle, &fd_handle, FRAMER_NONE);
+            compressor_state_deinit(&compressor_state);
+            zmsg_destroy(&sub_handle.pending_msg);
+          }
+          if (sub != NULL) {
             zsock_destroy(&sub);
             assert(sub == NULL);
           }
@@ -712,6 +1061,12 @@ int main(int argc, char *argv[])
   /* Prevent czmq from catching signals */
   zsys_handler_set(NULL);
 
+  /* Scheduling policy and affinity are inherited by child processes. Memory
+   * is locked here so that a failure is reported at startup. */
+  if ((daemon_sched_setup() != 0) || (daemon_memory_lock() != 0)) {
+    exit(1);
+  }
+
   int ret = 0;
 
   switch (io_mode) {
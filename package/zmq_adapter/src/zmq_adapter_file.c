@@ -12,6 +12,8 @@
 
 #include "zmq_adapter.h"
 
+#include <daemon_util.h>
+
 int file_loop(const char *file_path)
 {
   int fd = open(file_path, O_RDWR);
@@ -21,6 +23,7 @@ int file_loop(const char *file_path)
   }
 
   io_loop_start(fd);
+  daemon_ready_notify();
   while(waitpid(-1, NULL, 0) >= 0) {
     ;
   }
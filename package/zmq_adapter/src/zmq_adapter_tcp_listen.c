@@ -12,6 +12,8 @@
 
 #include "zmq_adapter.h"
 
+#include <daemon_util.h>
+
 #define SOCKET_LISTEN_BACKLOG_LENGTH 16
 
 static int socket_create(int port)
@@ -90,6 +92,7 @@ int tcp_listen_loop(int port)
     return 1;
   }
 
+  daemon_ready_notify();
   server_loop(server_fd);
 
   close(server_fd);
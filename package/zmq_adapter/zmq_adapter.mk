@@ -7,7 +7,7 @@
 ZMQ_ADAPTER_VERSION = 0.1
 ZMQ_ADAPTER_SITE = "${BR2_EXTERNAL}/package/zmq_adapter/src"
 ZMQ_ADAPTER_SITE_METHOD = local
-ZMQ_ADAPTER_DEPENDENCIES = czmq libsbp
+ZMQ_ADAPTER_DEPENDENCIES = czmq libsbp lz4 daemon_util
 
 define ZMQ_ADAPTER_BUILD_CMDS
     $(MAKE) CC=$(TARGET_CC) LD=$(TARGET_LD) -C $(@D) all
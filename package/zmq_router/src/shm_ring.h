@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_SHM_RING_H
+#define SWIFTNAV_SHM_RING_H
+
+/* Single writer, multiple reader broadcast ring in POSIX shared memory.
+ *
+ * The writer never waits for readers. Each reader keeps its own cursor
+ * and detects when the writer has lapped it. Records are a u32 length
+ * followed by the message, padded to 4 bytes. A length of
+ * SHM_RING_WRAP marks the remainder of the data area as unused.
+ *
+ * Positions are free running byte counts. Before writing a record the
+ * writer advances reserve_pos to the end of the region it is about to
+ * overwrite; write_pos is advanced once the record is complete. A reader
+ * may use data at position p for as long as reserve_pos - p <= data_size.
+ *
+ * The writer increments seq and wakes all futex waiters on it after each
+ * batch of records. Readers map the ring read-only.
+ *
+ * This header is self-contained so that local consumers need no library:
+ *
+ *   shm_ring_reader_t r;
+ *   shm_ring_reader_open(&r, "/sbp");
+ *   while (1) {
+ *     const uint8_t *data;
+ *     uint32_t length;
+ *     int ret = shm_ring_reader_next(&r, &data, &length);
+ *     if (ret == 0) {
+ *       shm_ring_reader_wait(&r, 1000);
+ *     } else if (ret > 0) {
+ *       process(data, length);
+ *       if (!shm_ring_reader_valid(&r)) {
+ *         // data was overwritten while being processed
+ *       }
+ *     }
+ *   }
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SHM_RING_MAGIC 0x474e5253 /* "SRNG" */
+#define SHM_RING_VERSION 1
+#define SHM_RING_WRAP 0xffffffff
+#define SHM_RING_ALIGN 4
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t data_size;
+  uint32_t seq;
+  uint64_t write_pos;
+  uint64_t reserve_pos;
+  uint8_t reserved[32];
+} shm_ring_header_t;
+
+typedef struct {
+  const shm_ring_header_t *header;
+  const uint8_t *data;
+  size_t map_size;
+  uint64_t read_pos;
+  uint64_t record_pos;
+  uint64_t overruns;
+} shm_ring_reader_t;
+
+static inline uint32_t shm_ring_record_size(uint32_t length)
+{
+  return sizeof(uint32_t) +
+         ((length + SHM_RING_ALIGN - 1) & ~(SHM_RING_ALIGN - 1));
+}
+
+static inline int shm_ring_reader_open(shm_ring_reader_t *r,
+                                       const char *name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if ((fstat(fd, &st) != 0) ||
+      ((size_t)st.st_size < sizeof(shm_ring_header_t))) {
+    close(fd);
+    return -1;
+  }
+
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return -1;
+  }
+
+  const shm_ring_header_t *header = (const shm_ring_header_t *)map;
+  if ((header->magic != SHM_RING_MAGIC) ||
+      (header->version != SHM_RING_VERSION) ||
+      (sizeof(shm_ring_header_t) + header->data_size >
+       (size_t)st.st_size)) {
+    munmap(map, st.st_size);
+    errno = EINVAL;
+    return -1;
+  }
+
+  r->header = header;
+  r->data = (const uint8_t *)map + sizeof(shm_ring_header_t);
+  r->map_size = st.st_size;
+  /* Start with the next message published */
+  r->read_pos = __atomic_load_n(&header->write_pos, __ATOMIC_ACQUIRE);
+  r->record_pos = r->read_pos;
+  r->overruns = 0;
+  return 0;
+}
+
+static inline void shm_ring_reader_close(shm_ring_reader_t *r)
+{
+  munmap((void *)r->header, r->map_size);
+  r->header = NULL;
+}
+
+/* True if the record returned by the last call to shm_ring_reader_next()
+ * has not been overwritten. Call after using the data in place. */
+static inline bool shm_ring_reader_valid(const shm_ring_reader_t *r)
+{
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  uint64_t reserve_pos = __atomic_load_n(&r->header->reserve_pos,
+                                         __ATOMIC_RELAXED);
+  return reserve_pos - r->record_pos <= r->header->data_size;
+}
+
+/* Returns 1 and points data at the next message, 0 if there is none yet,
+ * or -1 if the writer lapped the reader, in which case the cursor is
+ * moved to the newest message. */
+static inline int shm_ring_reader_next(shm_ring_reader_t *r,
+                                       const uint8_t **data,
+                                       uint32_t *length)
+{
+  const uint32_t data_size = r->header->data_size;
+
+  while (1) {
+    uint64_t write_pos = __atomic_load_n(&r->header->write_pos,
+                                         __ATOMIC_ACQUIRE);
+    if (r->read_pos == write_pos) {
+      return 0;
+    }
+
+    if (write_pos - r->read_pos > data_size) {
+      r->read_pos = write_pos;
+      r->overruns++;
+      return -1;
+    }
+
+    uint32_t offset = r->read_pos & (data_size - 1);
+    uint32_t record_length;
+    __builtin_memcpy(&record_length, &r->data[offset], sizeof(record_length));
+
+    r->record_pos = r->read_pos;
+    if (record_length == SHM_RING_WRAP) {
+      r->read_pos += data_size - offset;
+    } else if (offset + shm_ring_record_size(record_length) <= data_size) {
+      r->read_pos += shm_ring_record_size(record_length);
+    } else {
+      /* Length was overwritten, caught below */
+      r->read_pos = write_pos;
+    }
+
+    if (!shm_ring_reader_valid(r)) {
+      r->read_pos = __atomic_load_n(&r->header->write_pos, __ATOMIC_ACQUIRE);
+      r->overruns++;
+      return -1;
+    }
+
+    if (record_length != SHM_RING_WRAP) {
+      *data = &r->data[offset + sizeof(uint32_t)];
+      *length = record_length;
+      return 1;
+    }
+  }
+}
+
+/* Wait up to timeout_ms for the writer to publish, -1 to wait forever */
+static inline void shm_ring_reader_wait(shm_ring_reader_t *r, int timeout_ms)
+{
+  uint32_t seq = __atomic_load_n(&r->header->seq, __ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&r->header->write_pos, __ATOMIC_ACQUIRE) !=
+      r->read_pos) {
+    return;
+  }
+
+  struct timespec timeout = {
+    .tv_sec = timeout_ms / 1000,
+    .tv_nsec = (timeout_ms % 1000) * 1000000
+  };
+  syscall(SYS_futex, &r->header->seq, FUTEX_WAIT, seq,
+          (timeout_ms < 0) ? NULL : &timeout, NULL, 0);
+}
+
+#endif /* SWIFTNAV_SHM_RING_H */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#include "shm_ring_writer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+struct shm_ring_writer_s {
+  shm_ring_header_t *header;
+  uint8_t *data;
+  size_t map_size;
+  uint64_t pending_pos;
+};
+
+shm_ring_writer_t * shm_ring_writer_create(const char *name,
+                                           uint32_t data_size)
+{
+  if ((data_size == 0) || ((data_size & (data_size - 1)) != 0)) {
+    printf("shm ring size must be a power of two\n");
+    return NULL;
+  }
+
+  shm_ring_writer_t *w = calloc(1, sizeof(*w));
+  if (w == NULL) {
+    return NULL;
+  }
+
+  int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    printf("shm_open() error: %s\n", strerror(errno));
+    free(w);
+    return NULL;
+  }
+
+  w->map_size = sizeof(shm_ring_header_t) + data_size;
+  if (ftruncate(fd, w->map_size) != 0) {
+    printf("ftruncate() error: %s\n", strerror(errno));
+    close(fd);
+    free(w);
+    return NULL;
+  }
+
+  void *map = mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    printf("mmap() error: %s\n", strerror(errno));
+    free(w);
+    return NULL;
+  }
+
+  w->header = (shm_ring_header_t *)map;
+  w->data = (uint8_t *)map + sizeof(shm_ring_header_t);
+
+  /* Continue an existing ring after a restart so that readers which
+   * still have it mapped pick up where they left off */
+  if ((w->header->magic != SHM_RING_MAGIC) ||
+      (w->header->version != SHM_RING_VERSION) ||
+      (w->header->data_size != data_size)) {
+    w->header->magic = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    w->header->version = SHM_RING_VERSION;
+    w->header->data_size = data_size;
+    w->header->seq = 0;
+    w->header->write_pos = 0;
+    w->header->reserve_pos = 0;
+    __atomic_store_n(&w->header->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+  }
+
+  w->pending_pos = w->header->write_pos;
+  return w;
+}
+
+void shm_ring_writer_destroy(shm_ring_writer_t **writer)
+{
+  shm_ring_writer_t *w = *writer;
+  munmap(w->header, w->map_size);
+  free(w);
+  *writer = NULL;
+}
+
+uint8_t * shm_ring_writer_reserve(shm_ring_writer_t *w, uint32_t length)
+{
+  const uint32_t data_size = w->header->data_size;
+  uint32_t record_size = shm_ring_record_size(length);
+  if ((length == SHM_RING_WRAP) || (record_size > data_size / 4)) {
+    return NULL;
+  }
+
+  uint64_t pos = w->header->write_pos;
+  uint32_t offset = pos & (data_size - 1);
+  bool wrap = (offset + record_size > data_size);
+  uint64_t end = pos + record_size + (wrap ? data_size - offset : 0);
+
+  /* Claim the region before overwriting it so that readers still using
+   * the old contents can tell */
+  __atomic_store_n(&w->header->reserve_pos, end, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  if (wrap) {
+    uint32_t marker = SHM_RING_WRAP;
+    memcpy(&w->data[offset], &marker, sizeof(marker));
+    offset = 0;
+  }
+
+  memcpy(&w->data[offset], &length, sizeof(length));
+  w->pending_pos = end;
+  return &w->data[offset + sizeof(uint32_t)];
+}
+
+void shm_ring_writer_commit(shm_ring_writer_t *w)
+{
+  __atomic_store_n(&w->header->write_pos, w->pending_pos, __ATOMIC_RELEASE);
+}
+
+void shm_ring_writer_notify(shm_ring_writer_t *w)
+{
+  __atomic_add_fetch(&w->header->seq, 1, __ATOMIC_RELEASE);
+  syscall(SYS_futex, &w->header->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
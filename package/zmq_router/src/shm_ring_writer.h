@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2016 Swift Navigation Inc.
+ * Contact: Jacob McNamee <jacob@swiftnav.com>
+ *
+ * This source is subject to the license found in the file 'LICENSE' which must
+ * be be distributed together with this source. All other rights reserved.
+ *
+ * THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF ANY KIND,
+ * EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef SWIFTNAV_SHM_RING_WRITER_H
+#define SWIFTNAV_SHM_RING_WRITER_H
+
+#include "shm_ring.h"
+
+typedef struct shm_ring_writer_s shm_ring_writer_t;
+
+/* data_size must be a power of two */
+shm_ring_writer_t * shm_ring_writer_create(const char *name,
+                                           uint32_t data_size);
+void shm_ring_writer_destroy(shm_ring_writer_t **writer);
+
+/* Returns space for a message of the given length, to be filled in and
+ * then published with shm_ring_writer_commit() */
+uint8_t * shm_ring_writer_reserve(shm_ring_writer_t *writer, uint32_t length);
+void shm_ring_writer_commit(shm_ring_writer_t *writer);
+
+/* Wake waiting readers. Call once per batch of messages. */
+void shm_ring_writer_notify(shm_ring_writer_t *writer);
+
+#endif /* SWIFTNAV_SHM_RING_WRITER_H */
@@ -11,31 +11,151 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include <daemon_util.h>
 
 #include "zmq_router.h"
 
+#define RX_BATCH_MAX 64
+#define PUB_QUEUE_HWM_DEFAULT 1024
+#define PUB_FLUSH_RETRY_ms 5
+#define DROP_REPORT_INTERVAL_ms 1000
+#define SHM_SIZE_DEFAULT (1024 * 1024)
+
 extern const router_t router_sbp;
 
 static const router_t * const routers[] = {
   &router_sbp
 };
 
+static bool shm_enabled = false;
+
+static void usage(char *command)
+{
+  printf("Usage: %s\n", command);
+
+  daemon_usage();
+
+  puts("\nRouter options");
+  puts("\t--shm");
+  puts("\t\tenable shared memory output ports, see shm_ring.h");
+}
+
+static int parse_options(int argc, char *argv[])
+{
+  enum {
+    OPT_ID_SHM = 1
+  };
+
+  const struct option long_opts[] = {
+    DAEMON_LONG_OPTS,
+    {"shm",         no_argument,       0, OPT_ID_SHM},
+    {0, 0, 0, 0}
+  };
+
+  int c;
+  int opt_index;
+  while ((c = getopt_long(argc, argv, "",
+                          long_opts, &opt_index)) != -1) {
+    switch (c) {
+      case OPT_ID_SHM: {
+        shm_enabled = true;
+      }
+      break;
+
+      default: {
+        if (daemon_option(c, optarg) != 0) {
+          return -1;
+        }
+      }
+      break;
+    }
+  }
+
+  return 0;
+}
+
+static int priority_classes_count(const router_t *router)
+{
+  int count = 0;
+  if (router->priority_classes != NULL) {
+    while (router->priority_classes[count] != NULL) {
+      count++;
+    }
+  }
+  return count;
+}
+
 static void router_setup(const router_t *router)
 {
+  int classes_count = priority_classes_count(router);
+
   for (int i=0; i<router->ports_count; i++) {
     port_t *port = &router->ports[i];
 
-    port->pub_socket = zsock_new_pub(port->config.pub_addr);
-    if (port->pub_socket == NULL) {
-      printf("zsock_new_pub() error\n");
-      exit(1);
+    int queues_count = 1;
+    if (port->config.pub_prioritized && (classes_count > 0)) {
+      queues_count = classes_count;
     }
 
-    port->sub_socket = zsock_new_sub(port->config.sub_addr, "");
-    if (port->sub_socket == NULL) {
-      printf("zsock_new_sub() error\n");
+    port->priority_classes = router->priority_classes;
+    port->pub_queues_count = queues_count;
+    port->pub_flush_timer = -1;
+    port->pub_queues = calloc(queues_count, sizeof(zlist_t *));
+    if (port->pub_queues == NULL) {
+      printf("calloc() error\n");
       exit(1);
     }
+    for (int j=0; j<queues_count; j++) {
+      port->pub_queues[j] = zlist_new();
+      if (port->pub_queues[j] == NULL) {
+        printf("zlist_new() error\n");
+        exit(1);
+      }
+    }
+
+    /* Ports may omit either socket, e.g. shared memory output only */
+    if (port->config.pub_addr != NULL) {
+      port->pub_socket = zsock_new_pub(port->config.pub_addr);
+      if (port->pub_socket == NULL) {
+        printf("zsock_new_pub() error\n");
+        exit(1);
+      }
+
+      /* Have sends fail rather than drop when the subscriber is full, so
+       * that messages back up in the priority queues instead. This
+       * applies to all subscribers, so only do it for a single one. */
+      if (port->config.pub_prioritized) {
+        int nodrop = 1;
+        if (zmq_setsockopt(zsock_resolve(port->pub_socket), ZMQ_XPUB_NODROP,
+                           &nodrop, sizeof(nodrop)) != 0) {
+          printf("zmq_setsockopt() error\n");
+          exit(1);
+        }
+      }
+    }
+
+    if (port->config.sub_addr != NULL) {
+      port->sub_socket = zsock_new_sub(port->config.sub_addr, "");
+      if (port->sub_socket == NULL) {
+        printf("zsock_new_sub() error\n");
+        exit(1);
+      }
+    }
+
+    /* Ports left without any output are skipped when forwarding */
+    if (shm_enabled && (port->config.shm_name != NULL)) {
+      uint32_t shm_size = port->config.shm_size > 0 ?
+          port->config.shm_size : SHM_SIZE_DEFAULT;
+      port->shm_ring = shm_ring_writer_create(port->config.shm_name,
+                                              shm_size);
+      if (port->shm_ring == NULL) {
+        printf("shm_ring_writer_create() error\n");
+        exit(1);
+      }
+    }
   }
 }
 
@@ -54,6 +174,19 @@ static void router_destroy(const router_t *router)
     assert(port->pub_socket == NULL);
     zsock_destroy(&port->sub_socket);
     assert(port->sub_socket == NULL);
+    if (port->shm_ring != NULL) {
+      shm_ring_writer_destroy(&port->shm_ring);
+    }
+
+    for (int j=0; j<port->pub_queues_count; j++) {
+      zmsg_t *msg;
+      while ((msg = zlist_pop(port->pub_queues[j])) != NULL) {
+        zmsg_destroy(&msg);
+      }
+      zlist_destroy(&port->pub_queues[j]);
+    }
+    free(port->pub_queues);
+    port->pub_queues = NULL;
   }
 }
 
@@ -69,6 +202,10 @@ static void loop_add_router(zloop_t *loop, const router_t *router,
 {
   for (int i=0; i<router->ports_count; i++) {
     port_t *port = &router->ports[i];
+    if (port->sub_socket == NULL) {
+      continue;
+    }
+
     int result;
     result = zloop_reader(loop, port->sub_socket, reader_fn, port);
     if (result != 0) {
@@ -86,21 +223,256 @@ static void loop_setup(zloop_t *loop, const router_t * const routers[],
   }
 }
 
+static const filter_t * filter_match(const filter_t * const *filters,
+                                     const void *prefix, int prefix_len)
+{
+  /* Iterate over filters */
+  int filter_index = 0;
+  while (1) {
+    const filter_t *filter = filters[filter_index++];
+    if (filter == NULL) {
+      break;
+    }
+
+    /* Empty filter matches all */
+    if (filter->len == 0) {
+      return filter;
+    } else if (prefix != NULL) {
+      if ((prefix_len >= filter->len) &&
+          (memcmp(prefix, filter->data, filter->len) == 0)) {
+        return filter;
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static int priority_class_get(const port_t *port,
+                              const void *prefix, int prefix_len)
+{
+  if (port->priority_classes == NULL) {
+    return 0;
+  }
+
+  /* Use the first class with an accepting filter match */
+  int i;
+  for (i=0; port->priority_classes[i] != NULL; i++) {
+    const filter_t *filter = filter_match(port->priority_classes[i]->filters,
+                                          prefix, prefix_len);
+    if ((filter != NULL) && (filter->action == FILTER_ACTION_ACCEPT)) {
+      return i;
+    }
+  }
+
+  /* Default to the lowest priority class */
+  return (i > 0) ? i - 1 : 0;
+}
+
+static void pub_queue_drops_report(port_t *port)
+{
+  int64_t now_ms = zclock_mono();
+  if (now_ms - port->pub_queue_drops_report_ms < DROP_REPORT_INTERVAL_ms) {
+    return;
+  }
+
+  printf("queue full, %llu messages dropped\n",
+         (unsigned long long)(port->pub_queue_drops -
+                              port->pub_queue_drops_reported));
+  port->pub_queue_drops_reported = port->pub_queue_drops;
+  port->pub_queue_drops_report_ms = now_ms;
+}
+
+static void pub_queue_push(port_t *port, int priority, zmsg_t **msg)
+{
+  size_t hwm = PUB_QUEUE_HWM_DEFAULT;
+  if (port->pub_queues_count > 1) {
+    hwm = port->priority_classes[priority]->hwm;
+  } else {
+    priority = 0;
+  }
+
+  zlist_t *queue = port->pub_queues[priority];
+  if (zlist_size(queue) >= hwm) {
+    port->pub_queue_drops++;
+    pub_queue_drops_report(port);
+    zmsg_destroy(msg);
+    return;
+  }
+
+  if (zlist_append(queue, *msg) != 0) {
+    printf("zlist_append() error\n");
+    zmsg_destroy(msg);
+    return;
+  }
+
+  *msg = NULL;
+}
+
+static void shm_ring_write(shm_ring_writer_t *shm_ring, zmsg_t *msg)
+{
+  /* Frames are concatenated into a single record */
+  uint8_t *data = shm_ring_writer_reserve(shm_ring, zmsg_content_size(msg));
+  if (data == NULL) {
+    printf("shm ring message too large\n");
+    return;
+  }
+
+  zframe_t *frame = zmsg_first(msg);
+  while (frame != NULL) {
+    memcpy(data, zframe_data(frame), zframe_size(frame));
+    data += zframe_size(frame);
+    frame = zmsg_next(msg);
+  }
+
+  shm_ring_writer_commit(shm_ring);
+}
+
+/* Send a message without blocking, leaving it intact on failure */
+static int pub_msg_send(zsock_t *socket, zmsg_t *msg)
+{
+  /* Once the first frame is accepted the rest of the message is too */
+  size_t frames_count = zmsg_size(msg);
+  size_t frame_index = 0;
+  zframe_t *frame = zmsg_first(msg);
+  while (frame != NULL) {
+    int flags = ZFRAME_REUSE | ZFRAME_DONTWAIT;
+    if (++frame_index < frames_count) {
+      flags |= ZFRAME_MORE;
+    }
+    if (zframe_send(&frame, socket, flags) != 0) {
+      return -1;
+    }
+    frame = zmsg_next(msg);
+  }
+  return 0;
+}
+
+static void pub_queues_flush(zloop_t *loop, port_t *port);
+
+static int pub_flush_timer_fn(zloop_t *loop, int timer_id, void *arg)
+{
+  port_t *port = (port_t *)arg;
+  port->pub_flush_timer = -1;
+  pub_queues_flush(loop, port);
+  return 0;
+}
+
+static void pub_queues_flush(zloop_t *loop, port_t *port)
+{
+  bool shm_written = false;
+  bool blocked = false;
+
+  /* Send queued messages, highest priority first. Stop when the PUB
+   * socket is full so that lower priority messages wait in their queues
+   * and any new higher priority messages go ahead of them. */
+  for (int i=0; (i<port->pub_queues_count) && !blocked; i++) {
+    zmsg_t *msg;
+    while ((msg = zlist_first(port->pub_queues[i])) != NULL) {
+      if ((port->pub_socket != NULL) &&
+          (pub_msg_send(port->pub_socket, msg) != 0)) {
+        if (errno == EAGAIN) {
+          blocked = true;
+          break;
+        }
+        printf("zmsg_send() error\n");
+      } else if (port->shm_ring != NULL) {
+        shm_ring_write(port->shm_ring, msg);
+        shm_written = true;
+      }
+
+      zlist_remove(port->pub_queues[i], msg);
+      zmsg_destroy(&msg);
+    }
+  }
+
+  /* Wake readers once per batch */
+  if (shm_written) {
+    shm_ring_writer_notify(port->shm_ring);
+  }
+
+  if (blocked && (port->pub_flush_timer == -1)) {
+    port->pub_flush_timer = zloop_timer(loop, PUB_FLUSH_RETRY_ms, 1,
+                                        pub_flush_timer_fn, port);
+  }
+}
+
+static bool filter_throttle_accept(const filter_t *filter)
+{
+  if (filter->state == NULL) {
+    return true;
+  }
+
+  if (filter->decimation > 1) {
+    /* Accept the first of every decimation messages */
+    uint32_t count = filter->state->count;
+    if (++filter->state->count >= (uint32_t)filter->decimation) {
+      filter->state->count = 0;
+    }
+    if (count != 0) {
+      return false;
+    }
+  }
+
+  if (filter->period_ms > 0) {
+    int64_t now_ms = zclock_mono();
+    if ((filter->state->last_time_ms != 0) &&
+        (now_ms - filter->state->last_time_ms < filter->period_ms)) {
+      return false;
+    }
+    filter->state->last_time_ms = now_ms;
+  }
+
+  return true;
+}
+
+static bool rate_limit_accept(rate_limit_t *rate_limit, size_t size)
+{
+  if (rate_limit == NULL) {
+    return true;
+  }
+
+  /* Refill the token bucket. The refill time is only advanced once at
+   * least one token has been added so that low rates are not lost to
+   * rounding. */
+  int64_t now_ms = zclock_mono();
+  int64_t refill = (now_ms - rate_limit->last_time_ms) *
+                   rate_limit->bytes_per_s / 1000;
+  if (refill > 0) {
+    rate_limit->tokens = MIN(rate_limit->tokens + refill,
+                             rate_limit->burst_bytes);
+    rate_limit->last_time_ms = now_ms;
+  }
+
+  if (rate_limit->tokens < (int64_t)size) {
+    return false;
+  }
+
+  rate_limit->tokens -= size;
+  return true;
+}
+
 static void process_filter_match(const forwarding_rule_t *forwarding_rule,
-                                 const filter_t *filter, zmsg_t *msg)
+                                 const filter_t *filter, zmsg_t *msg,
+                                 int priority)
 {
   switch (filter->action) {
   case FILTER_ACTION_ACCEPT: {
+    /* Drop throttled messages before they are copied */
+    if (!filter_throttle_accept(filter)) {
+      break;
+    }
+    if (!rate_limit_accept(forwarding_rule->rate_limit,
+                           zmsg_content_size(msg))) {
+      break;
+    }
+
     zmsg_t *tx_msg = zmsg_dup(msg);
     if (tx_msg == NULL) {
       printf("zmsg_dup() error\n");
       break;
     }
-    int result = zmsg_send(&tx_msg, forwarding_rule->dst_port->pub_socket);
-    if (result != 0) {
-      printf("zmsg_send() error\n");
-      break;
-    }
+    pub_queue_push(forwarding_rule->dst_port, priority, &tx_msg);
   }
   break;
 
@@ -117,47 +489,25 @@ static void process_filter_match(const forwarding_rule_t *forwarding_rule,
 }
 
 static void process_rule(const forwarding_rule_t *forwarding_rule,
-                         const void *prefix, int prefix_len, zmsg_t *msg)
+                         const void *prefix, int prefix_len, zmsg_t *msg,
+                         int priority)
 {
-  /* Iterate over filters for this rule */
-  int filter_index = 0;
-  while (1) {
-    const filter_t *filter = forwarding_rule->filters[filter_index++];
-    if (filter == NULL) {
-      break;
-    }
-
-    bool match = false;
-
-    /* Empty filter matches all */
-    if (filter->len == 0) {
-      match = true;
-    } else if (prefix != NULL) {
-      if ((prefix_len >= filter->len) &&
-          (memcmp(prefix, filter->data, filter->len) == 0)) {
-        match = true;
-      }
-    }
-
-    if (match) {
-      process_filter_match(forwarding_rule, filter, msg);
+  /* Nothing to do for a port with no outputs */
+  const port_t *dst_port = forwarding_rule->dst_port;
+  if ((dst_port->pub_socket == NULL) && (dst_port->shm_ring == NULL)) {
+    return;
+  }
 
-      /* Done with this rule after finding a filter match */
-      break;
-    }
+  /* Done with this rule after finding a filter match */
+  const filter_t *filter = filter_match(forwarding_rule->filters,
+                                        prefix, prefix_len);
+  if (filter != NULL) {
+    process_filter_match(forwarding_rule, filter, msg, priority);
   }
 }
 
-static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
+static void process_msg(port_t *port, zmsg_t *rx_msg)
 {
-  port_t *port = (port_t *)arg;
-
-  zmsg_t *rx_msg = zmsg_recv(port->sub_socket);
-  if (rx_msg == NULL) {
-    printf("zmsg_recv() error\n");
-    return 0;
-  }
-
   /* Get first frame for filtering */
   zframe_t *rx_frame_first = zmsg_first(rx_msg);
   const void *rx_prefix = NULL;
@@ -167,6 +517,8 @@ static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
     rx_prefix_len = zframe_size(rx_frame_first);
   }
 
+  int priority = priority_class_get(port, rx_prefix, rx_prefix_len);
+
   /* Iterate over forwarding rules */
   int rule_index = 0;
   while (1) {
@@ -176,20 +528,61 @@ static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
       break;
     }
 
-    process_rule(forwarding_rule, rx_prefix, rx_prefix_len, rx_msg);
+    process_rule(forwarding_rule, rx_prefix, rx_prefix_len, rx_msg, priority);
+  }
+}
+
+static int reader_fn(zloop_t *loop, zsock_t *reader, void *arg)
+{
+  port_t *port = (port_t *)arg;
+
+  /* Receive any messages which are already queued, up to a limit,
+   * so that they may be reordered by priority before forwarding */
+  int rx_count = 0;
+  do {
+    zmsg_t *rx_msg = zmsg_recv(port->sub_socket);
+    if (rx_msg == NULL) {
+      printf("zmsg_recv() error\n");
+      break;
+    }
+
+    process_msg(port, rx_msg);
+    zmsg_destroy(&rx_msg);
+  } while ((++rx_count < RX_BATCH_MAX) &&
+           (zsock_events(port->sub_socket) & ZMQ_POLLIN));
+
+  /* Forward queued messages */
+  int rule_index = 0;
+  while (1) {
+    const forwarding_rule_t *forwarding_rule =
+        port->config.sub_forwarding_rules[rule_index++];
+    if (forwarding_rule == NULL) {
+      break;
+    }
+
+    pub_queues_flush(loop, forwarding_rule->dst_port);
   }
 
-  zmsg_destroy(&rx_msg);
   return 0;
 }
 
-int main (void)
+int main(int argc, char *argv[])
 {
+  if (parse_options(argc, argv) != 0) {
+    usage(argv[0]);
+    exit(1);
+  }
+
+  if ((daemon_sched_setup() != 0) || (daemon_memory_lock() != 0)) {
+    exit(1);
+  }
+
   routers_setup(routers, sizeof(routers)/sizeof(routers[0]));
 
   zloop_t *loop = zloop_new();
   assert(loop);
   loop_setup(loop, routers, sizeof(routers)/sizeof(routers[0]), reader_fn);
+  daemon_ready_notify();
 
   zloop_start(loop);
 
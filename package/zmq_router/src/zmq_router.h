@@ -18,6 +18,8 @@
 
 #include <czmq.h>
 
+#include "shm_ring_writer.h"
+
 #define FILTER(filter_action, ...)                                            \
   (filter_t) {                                                                \
     .data = (const uint8_t[]){ __VA_ARGS__ },                                 \
@@ -25,40 +27,105 @@
     .action = filter_action                                                   \
   }
 
+#define FILTER_THROTTLED(filter_action, filter_decimation,                    \
+                         filter_period_ms, ...)                               \
+  (filter_t) {                                                                \
+    .data = (const uint8_t[]){ __VA_ARGS__ },                                 \
+    .len = sizeof((const uint8_t[]){ __VA_ARGS__ }),                          \
+    .action = filter_action,                                                  \
+    .decimation = filter_decimation,                                          \
+    .period_ms = filter_period_ms,                                            \
+    .state = &(filter_state_t){ .count = 0, .last_time_ms = 0 }               \
+  }
+
 #define FILTER_ACCEPT(...) FILTER(FILTER_ACTION_ACCEPT, __VA_ARGS__ )
 #define FILTER_REJECT(...) FILTER(FILTER_ACTION_REJECT, __VA_ARGS__ )
 
+/* Accept every Nth matching message */
+#define FILTER_ACCEPT_DECIMATE(n, ...)                                        \
+  FILTER_THROTTLED(FILTER_ACTION_ACCEPT, n, 0, __VA_ARGS__ )
+/* Accept at most one matching message per period */
+#define FILTER_ACCEPT_PERIOD(period_ms, ...)                                  \
+  FILTER_THROTTLED(FILTER_ACTION_ACCEPT, 0, period_ms, __VA_ARGS__ )
+
+#define RATE_LIMIT(limit_bytes_per_s, limit_burst_bytes)                      \
+  (rate_limit_t) {                                                            \
+    .bytes_per_s = limit_bytes_per_s,                                         \
+    .burst_bytes = limit_burst_bytes,                                         \
+    .tokens = limit_burst_bytes,                                              \
+    .last_time_ms = 0                                                         \
+  }
+
 typedef enum {
   FILTER_ACTION_ACCEPT,
   FILTER_ACTION_REJECT,
 } filter_action_t;
 
+typedef struct {
+  uint32_t count;
+  int64_t last_time_ms;
+} filter_state_t;
+
 typedef struct {
   const uint8_t *data;
   int len;
   filter_action_t action;
+  int decimation;
+  int period_ms;
+  filter_state_t *state;
 } filter_t;
 
+typedef struct {
+  int bytes_per_s;
+  int burst_bytes;
+  int64_t tokens;
+  int64_t last_time_ms;
+} rate_limit_t;
+
 typedef struct {
   struct port_t *dst_port;
   const filter_t * const *filters;
+  rate_limit_t *rate_limit;
 } forwarding_rule_t;
 
+typedef struct {
+  const filter_t * const *filters;
+  int hwm;
+} priority_class_t;
+
 typedef struct {
   const char *pub_addr;
   const char *sub_addr;
   const forwarding_rule_t * const *sub_forwarding_rules;
+  /* Only set for a PUB socket with a single subscriber. Messages are then
+   * held in priority queues while the subscriber is full. Shared ports
+   * drop at the ZMQ HWM for each slow subscriber instead. */
+  bool pub_prioritized;
+  /* Optional shared memory output, see shm_ring.h */
+  const char *shm_name;
+  uint32_t shm_size;
 } port_config_t;
 
 typedef struct port_t {
   const port_config_t config;
   zsock_t *pub_socket;
   zsock_t *sub_socket;
+  shm_ring_writer_t *shm_ring;
+  const priority_class_t * const *priority_classes;
+  zlist_t **pub_queues;
+  int pub_queues_count;
+  /* Retries sending queued messages once the PUB socket is full, -1 if
+   * not scheduled */
+  int pub_flush_timer;
+  uint64_t pub_queue_drops;
+  uint64_t pub_queue_drops_reported;
+  int64_t pub_queue_drops_report_ms;
 } port_t;
 
 typedef struct {
   port_t *ports;
   int ports_count;
+  const priority_class_t * const *priority_classes;
 } router_t;
 
 #endif /* SWIFTNAV_ZMQ_ROUTER_H */
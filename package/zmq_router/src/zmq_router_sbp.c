@@ -10,18 +10,30 @@
  * WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A PARTICULAR PURPOSE.
  */
 
+#include <libsbp/file_io.h>
+#include <libsbp/logging.h>
+#include <libsbp/navigation.h>
+#include <libsbp/observation.h>
+#include <libsbp/settings.h>
+
 #include "zmq_router.h"
 
+#define SBP_PREAMBLE 0x55
+#define SBP_MSG_PREFIX(msg_type) \
+  SBP_PREAMBLE, ((msg_type) & 0xff), (((msg_type) >> 8) & 0xff)
+
 typedef enum {
   SBP_PORT_FIRMWARE,
   SBP_PORT_SETTINGS,
-  SBP_PORT_EXTERNAL
+  SBP_PORT_EXTERNAL,
+  SBP_PORT_LOCAL
 } sbp_port_id_t;
 
 static port_t ports_sbp[] = {
   [SBP_PORT_FIRMWARE] = {
     .config = {
       .pub_addr = "@tcp://127.0.0.1:43010",
+      .pub_prioritized = true,
       .sub_addr = "@tcp://127.0.0.1:43011",
       .sub_forwarding_rules = (const forwarding_rule_t *[]) {
         &(forwarding_rule_t){
@@ -38,6 +50,13 @@ static port_t ports_sbp[] = {
             NULL
           }
         },
+        &(forwarding_rule_t){
+          .dst_port = &ports_sbp[SBP_PORT_LOCAL],
+          .filters = (const filter_t *[]){
+            &FILTER_ACCEPT(),
+            NULL
+          }
+        },
         NULL
       },
     },
@@ -47,11 +66,14 @@ static port_t ports_sbp[] = {
   [SBP_PORT_SETTINGS] = {
     .config = {
       .pub_addr = "@tcp://127.0.0.1:43020",
+      .pub_prioritized = true,
       .sub_addr = "@tcp://127.0.0.1:43021",
       .sub_forwarding_rules = (const forwarding_rule_t *[]) {
         &(forwarding_rule_t){
           .dst_port = &ports_sbp[SBP_PORT_FIRMWARE],
           .filters = (const filter_t *[]) {
+            /* Settings reads answered from the daemon cache */
+            &FILTER_REJECT(SBP_MSG_PREFIX(SBP_MSG_SETTINGS_READ_RESP)),
             &FILTER_ACCEPT(),
             NULL
           }
@@ -63,6 +85,13 @@ static port_t ports_sbp[] = {
             NULL
           }
         },
+        &(forwarding_rule_t){
+          .dst_port = &ports_sbp[SBP_PORT_LOCAL],
+          .filters = (const filter_t *[]){
+            &FILTER_ACCEPT(),
+            NULL
+          }
+        },
         NULL
       },
     },
@@ -77,6 +106,8 @@ static port_t ports_sbp[] = {
         &(forwarding_rule_t){
           .dst_port = &ports_sbp[SBP_PORT_FIRMWARE],
           .filters = (const filter_t *[]) {
+            /* Served by the settings daemon, which forwards cache misses */
+            &FILTER_REJECT(SBP_MSG_PREFIX(SBP_MSG_SETTINGS_READ_REQ)),
             &FILTER_ACCEPT(),
             NULL
           }
@@ -93,10 +124,60 @@ static port_t ports_sbp[] = {
     },
     .pub_socket = NULL,
     .sub_socket = NULL,
+  },
+  [SBP_PORT_LOCAL] = {
+    /* Firmware and settings output for local consumers, only with --shm */
+    .config = {
+      .pub_addr = NULL,
+      .sub_addr = NULL,
+      .sub_forwarding_rules = NULL,
+      .shm_name = "/sbp",
+      .shm_size = 1024 * 1024,
+    },
+    .pub_socket = NULL,
+    .sub_socket = NULL,
   }
 };
 
 const router_t router_sbp = {
   .ports = ports_sbp,
   .ports_count = sizeof(ports_sbp)/sizeof(ports_sbp[0]),
+  .priority_classes = (const priority_class_t *[]) {
+    /* Time-critical solution and observation output */
+    &(priority_class_t){
+      .hwm = 256,
+      .filters = (const filter_t *[]) {
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_GPS_TIME)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_POS_ECEF)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_POS_LLH)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_BASELINE_ECEF)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_BASELINE_NED)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_VEL_ECEF)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_VEL_NED)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_OBS)),
+        &FILTER_ACCEPT(SBP_MSG_PREFIX(SBP_MSG_BASE_POS)),
+        NULL
+      }
+    },
+    /* Everything else except bulk transfers and logs */
+    &(priority_class_t){
+      .hwm = 1024,
+      .filters = (const filter_t *[]) {
+        &FILTER_REJECT(SBP_MSG_PREFIX(SBP_MSG_FILEIO_READ_RESP)),
+        &FILTER_REJECT(SBP_MSG_PREFIX(SBP_MSG_FILEIO_READ_DIR_RESP)),
+        &FILTER_REJECT(SBP_MSG_PREFIX(SBP_MSG_PRINT)),
+        &FILTER_ACCEPT(),
+        NULL
+      }
+    },
+    /* Bulk transfers and logs */
+    &(priority_class_t){
+      .hwm = 1024,
+      .filters = (const filter_t *[]) {
+        &FILTER_ACCEPT(),
+        NULL
+      }
+    },
+    NULL
+  }
 };